@@ -1,4 +1,5 @@
 #include "HIMEM.h"
+#include "HimemDrain.h"
 #include "SD_MMC.h"
 
 HIMEMLIB::HIMEM himem;
@@ -67,33 +68,22 @@ void setup() {
 
 ret = himem.getID("file_100.bin");
 Serial.printf("HIMEM ID for file %s is %d\n", himem.getFileName(ret), ret);
-/* write files in HIMEM to SD_MMC */ 
-for (int i = 0; i < numberOfFiles; i++) {
-  uint32_t fileSize = himem.getFilesize(i);
-  if (fileSize > fileBufSize) {
-    ESP_LOGE("setup", "Error: file larger than buffer, buffer: %d bytes, file: %d bytes for file ID %d", 
-      fileBufSize, fileSize, i);
-    stop;  
-  }
-  ret = himem.readFile(i, fileName, fileBuf);
-  if (ret == 0) {
-    ESP_LOGE("setup", "Failed to read file ID %d from HIMEM: %s, error code: %d", 
-      i, HIMEMLIB::errorToString(static_cast<HIMEMLIB::HimemError>(ret)), ret);
-    stop;
-  }
-  File file = SD_MMC.open("/" + fileName, FILE_WRITE);
-  if(!file){
-    ESP_LOGE("FILES", "Failed to open file for writing %s", fileName.c_str());
+/* write files in HIMEM to SD_MMC in the background, HIMEM reads overlap the SD writes */ 
+  HIMEMLIB::HimemDirSink sdSink("/sdcard");
+  HIMEMLIB::HimemDrain drainer(himem, sdSink);
+  if (drainer.begin() < 0) {
     stop;
   }
-  if(file.write(fileBuf, fileBufSize) != fileBufSize){
-    ESP_LOGE("FILES", "File Write failed %s", fileName.c_str());
-    file.close();
+  start = millis();
+  drainer.drain(0, numberOfFiles - 1);
+  drainer.waitIdle();
+  HIMEMLIB::HimemDrainStats stats = drainer.getStats();
+  drainer.end();
+  if (stats.failures > 0) {
+    ESP_LOGE("FILES", "%u files failed to write", stats.failures);
     stop;
   }
-  file.close();
-}  
-  ESP_LOGI("setup", "Wrote %d files from HIMEM to SD_MMC", numberOfFiles);
+  ESP_LOGI("setup", "Wrote %d files from HIMEM to SD_MMC in %lu ms", numberOfFiles, millis() - start);
 
 /* Free all HIMEM resources to start writing again */
   himem.freeMemory();
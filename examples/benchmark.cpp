@@ -0,0 +1,198 @@
+#include "HIMEM.h"
+#include <algorithm>
+
+/* -----------------------------------------------------------
+* HIMEM benchmark
+* Sweeps writeFile/readFile over file sizes and buffer alignment,
+* getID/getFilesize over store fill levels and times setBaseline.
+* Reports MB/s, p50/p99 latency and bank map/unmap calls per operation.
+* Runs on the device and on the host build (see ReadMe "Host Build").
+----------------------------------------------------------------*/
+
+HIMEMLIB::HIMEM himem;
+
+#define stop {delay(1000); while(1);}
+#define maxFileSize 200000
+#define maxSamples 64
+#define baselineSize 20000
+
+const uint32_t fileSizes[] = {1024, 4096, 15000, 32768, 65536, 100000, 200000};
+const uint8_t windowSizes[] = {1, 4};                   // map window banks, see create()
+const int fillLevels[] = {1, MAX_HIMEM_FILES / 4, MAX_HIMEM_FILES / 2, 3 * MAX_HIMEM_FILES / 4, MAX_HIMEM_FILES};
+
+uint8_t* benchBuf = nullptr;
+uint32_t samples[maxSamples];
+
+/* -----------------------------------------------------------
+* Print one result line
+* @param op - operation name
+* @param size - bytes per operation, 0 for metadata operations
+* @param label - alignment or fill level
+* @param n - number of samples taken
+* @param before - map stats when the samples started
+----------------------------------------------------------------*/
+void report(const char* op, uint32_t size, const char* label, int n, HIMEMLIB::HimemMapStats before) {
+  if (n == 0) {
+    Serial.printf("%-12s %7u %-10s  no samples\n", op, size, label);
+    return;
+  }
+  HIMEMLIB::HimemMapStats after = himem.getMapStats();
+  uint64_t total = 0;
+  for (int i = 0; i < n; i++) total += samples[i];
+  std::sort(samples, samples + n);
+  uint32_t p50 = samples[(n - 1) / 2];
+  uint32_t p99 = samples[((n - 1) * 99) / 100];
+  float mbps = (total > 0) ? ((float)size * n) / (float)total : 0.0f;   // bytes/us == MB/s
+  Serial.printf("%-12s %7u %-10s %4d %9.2f %9u %9u %8.2f %8.2f\n", op, size, label, n, mbps, p50, p99,
+    (float)(after.maps - before.maps) / n, (float)(after.unmaps - before.unmaps) / n);
+}
+
+void benchReadWrite(uint32_t size, bool aligned) {
+  uint8_t* buf = aligned ? benchBuf : benchBuf + 1;
+  const char* label = aligned ? "aligned" : "unaligned";
+  himem.freeMemory();
+  int n = 0;
+  HIMEMLIB::HimemMapStats before = himem.getMapStats();
+  while (n < maxSamples && himem.freespace() >= size && n < MAX_HIMEM_FILES) {
+    String fileName = "bench_" + String(n) + ".bin";
+    unsigned long start = micros();
+    int ret = himem.writeFile(n, fileName, buf, size);
+    samples[n] = micros() - start;
+    if (ret < 0) {
+      ESP_LOGE("bench", "writeFile failed: %s", HIMEMLIB::errorToString(static_cast<HIMEMLIB::HimemError>(ret)));
+      break;
+    }
+    n++;
+  }
+  report("writeFile", size, label, n, before);
+
+  int files = n;
+  before = himem.getMapStats();
+  for (n = 0; n < files; n++) {
+    String fileName;
+    unsigned long start = micros();
+    uint32_t bytesRead = himem.readFile(n, fileName, buf);
+    samples[n] = micros() - start;
+    if (bytesRead != size || buf[size - 1] != (uint8_t)((size - 1 + (aligned ? 0 : 1)) % 256)) {
+      ESP_LOGE("bench", "readFile verification failed for file %d", n);
+      stop;
+    }
+  }
+  report("readFile", size, label, n, before);
+}
+
+/* time lookups with the store filled with requested 1k files, return false if fewer fit */
+bool benchLookup(int requested) {
+  himem.freeMemory();
+  int fill = requested;
+  int fits = himem.freespace() / (1024 + sizeof(struct_HIMEM_FileInfo));   // files and their records
+  if (fill > fits) {
+    fill = fits;
+  }
+  for (int i = 0; i < fill; i++) {
+    String fileName = "frame_" + String(i) + ".jpg";
+    if (himem.writeFile(i, fileName, benchBuf, 1024) < 0) {
+      fill = i;
+      break;
+    }
+  }
+  if (fill < requested) {
+    Serial.printf("fill %d: only %d files of 1024 bytes fit, timed at fill %d\n", requested, fill, fill);
+  }
+  if (fill == 0) {
+    return false;
+  }
+  char label[16];
+  snprintf(label, sizeof(label), "fill %d", fill);
+
+  HIMEMLIB::HimemMapStats before = himem.getMapStats();
+  for (int n = 0; n < maxSamples; n++) {
+    int target = (n == 0) ? fill - 1 : (n * 7919) % fill;          // worst case first, then spread out
+    String fileName = "frame_" + String(target) + ".jpg";
+    unsigned long start = micros();
+    int id = himem.getID(fileName);
+    samples[n] = micros() - start;
+    if (id != target) {
+      ESP_LOGE("bench", "getID returned %d, expected %d", id, target);
+      stop;
+    }
+  }
+  report("getID", 0, label, maxSamples, before);
+
+  before = himem.getMapStats();
+  for (int n = 0; n < maxSamples; n++) {
+    unsigned long start = micros();
+    uint32_t size = himem.getFilesize((n * 7919) % fill);
+    samples[n] = micros() - start;
+    if (size != 1024) {
+      ESP_LOGE("bench", "getFilesize returned %u", size);
+      stop;
+    }
+  }
+  report("getFilesize", 0, label, maxSamples, before);
+  return fill == requested;
+}
+
+void benchBaseline() {
+  if (himem.writeBaseline(0, "baseline_0.jpg", benchBuf, baselineSize) < 0) {
+    ESP_LOGE("bench", "writeBaseline failed");
+    return;
+  }
+  HIMEMLIB::HimemMapStats before = himem.getMapStats();
+  int n;
+  for (n = 0; n < 16; n++) {
+    unsigned long start = micros();
+    int ret = himem.setBaseline(0);
+    samples[n] = micros() - start;
+    if (ret < 0) {
+      ESP_LOGE("bench", "setBaseline failed: %d", ret);
+      break;
+    }
+  }
+  report("setBaseline", baselineSize, "slot 0", n, before);
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+
+  benchBuf = (uint8_t*)malloc(maxFileSize + 4);
+  if (benchBuf == nullptr) {
+    ESP_LOGE("bench", "Failed to allocate %d byte benchmark buffer", maxFileSize + 4);
+    stop;
+  }
+  for (int i = 0; i < maxFileSize + 4; i++) {
+    benchBuf[i] = i % 256;
+  }
+
+  for (uint8_t window : windowSizes) {
+    himem.create(window);
+    HIMEMLIB::HimemMapStats stats = himem.getMapStats();
+    Serial.printf("\nHIMEM benchmark, %lu bytes free, %d max files, %d bank map window\n",
+      himem.freespace(), MAX_HIMEM_FILES, stats.windowBanks);
+    Serial.printf("%-12s %7s %-10s %4s %9s %9s %9s %8s %8s\n",
+      "operation", "bytes", "variant", "n", "MB/s", "p50(us)", "p99(us)", "maps/op", "unmap/op");
+
+    for (uint32_t size : fileSizes) {
+      benchReadWrite(size, true);
+      benchReadWrite(size, false);
+    }
+    for (int fill : fillLevels) {
+      if (!benchLookup(fill)) {
+        break;                                      // higher levels would time the same full store
+      }
+    }
+    benchBaseline();
+
+    stats = himem.getMapStats();
+    Serial.printf("window hits %u, misses %u, %u us in map/unmap\n",
+      stats.windowHits, stats.windowMisses, stats.mapMicros);
+    himem.destroy();
+  }
+  free(benchBuf);
+  benchBuf = nullptr;
+  Serial.println("Benchmark complete");
+}
+
+void loop() {
+}
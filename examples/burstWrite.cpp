@@ -0,0 +1,109 @@
+#include "HIMEM.h"
+
+/* -----------------------------------------------------------
+* Burst write example
+* A camera frame queue is drained into HIMEM in one writeFiles()
+* call instead of a writeFile() per frame. The batch is checked and
+* its space reserved once, the frames are copied back to back and
+* the records are published together. Both ways are timed with the
+* bank map counters.
+----------------------------------------------------------------*/
+
+HIMEMLIB::HIMEM himem;
+
+#define stop {delay(1000); while(1);}
+#define queueLength 32
+#define maxFrameSize 12000
+#define bursts 8
+
+uint8_t queue[queueLength][maxFrameSize];
+char names[queueLength][16];
+HIMEMLIB::HimemBatchEntry batch[queueLength];
+
+uint32_t frameBytes(int frame) {
+  return 2000 + (frame * 7717) % (maxFrameSize - 2000);
+}
+
+/* fill the queue with frames first to first + queueLength - 1 */
+void fillQueue(int first) {
+  for (int i = 0; i < queueLength; i++) {
+    int frame = first + i;
+    for (uint32_t j = 0; j < frameBytes(frame); j++) {
+      queue[i][j] = (uint8_t)(j * 3 + frame);
+    }
+    snprintf(names[i], sizeof(names[i]), "frame_%d.jpg", frame);
+    batch[i] = {names[i], queue[i], frameBytes(frame)};
+  }
+}
+
+bool checkFrames(int count) {
+  uint8_t buf[maxFrameSize];
+  for (int frame = 0; frame < count; frame++) {
+    String fileName;
+    if (himem.readFile(frame, fileName, buf) != frameBytes(frame) || fileName != "frame_" + String(frame) + ".jpg") {
+      return false;
+    }
+    for (uint32_t j = 0; j < frameBytes(frame); j++) {
+      if (buf[j] != (uint8_t)(j * 3 + frame)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+  ESP_LOGI("setup", "Start");
+
+  himem.create();
+
+/* one writeFile() per frame */
+  himem.resetMapStats();
+  unsigned long single = 0;
+  for (int b = 0; b < bursts; b++) {
+    fillQueue(b * queueLength);
+    unsigned long start = micros();
+    for (int i = 0; i < queueLength; i++) {
+      if (himem.writeFile(0, names[i], (uint8_t*)batch[i].buf, batch[i].bytes) < 0) {
+        stop;
+      }
+    }
+    single += micros() - start;
+  }
+  HIMEMLIB::HimemMapStats singleStats = himem.getMapStats();
+  bool match = checkFrames(bursts * queueLength);
+
+/* the same frames, one writeFiles() per burst */
+  himem.freeMemory();
+  himem.resetMapStats();
+  unsigned long batched = 0;
+  for (int b = 0; b < bursts; b++) {
+    fillQueue(b * queueLength);
+    unsigned long start = micros();
+    if (himem.writeFiles(batch, queueLength) != b * queueLength) {
+      ESP_LOGE("setup", "Burst %d failed", b);
+      stop;
+    }
+    batched += micros() - start;
+  }
+  HIMEMLIB::HimemMapStats batchStats = himem.getMapStats();
+  match = match && checkFrames(bursts * queueLength) && himem.getID("frame_40.jpg") == 40;
+
+  Serial.printf("%d bursts of %d frames\n", bursts, queueLength);
+  Serial.printf("writeFile:  %lu us per burst, %u maps\n", single / bursts, singleStats.maps);
+  Serial.printf("writeFiles: %lu us per burst, %u maps\n", batched / bursts, batchStats.maps);
+
+/* a batch that does not fit is refused as a whole */
+  uint16_t before = himem.getFileCount();
+  HIMEMLIB::HimemBatchEntry tooLong[2] = {{"ok.jpg", queue[0], 100}, {"this_name_is_far_too_long_for_a_himem_file.jpg", queue[1], 100}};
+  match = match && himem.writeFiles(tooLong, 2) < 0 && himem.getFileCount() == before;
+
+  if (match) {
+    Serial.println("Burst write verification successful");
+  }
+}
+
+void loop() {
+}
@@ -0,0 +1,154 @@
+#include "HIMEM.h"
+
+/* -----------------------------------------------------------
+* Compressed history example
+* Grayscale motion planes and text logs compress well, so storing
+* them with writeFile(..., true) keeps a much longer history in the
+* same HIMEM. readFile() returns the original bytes and getFilesize()
+* the original size; getStoredSize() is what the file uses in
+* HIMEM. Data that does not compress, like a JPEG, is stored raw
+* block by block and costs only 2 bytes per 4k.
+----------------------------------------------------------------*/
+
+HIMEMLIB::HIMEM himem;
+
+#define stop {delay(1000); while(1);}
+#define width 160
+#define height 120
+#define planeSize (width * height)
+#define frames 40
+
+uint8_t plane[planeSize];
+uint8_t readBuf[planeSize];
+
+/* a gradient background with a moving object, low bits of noise on every 8th pixel */
+void fillPlane(int n) {
+  uint32_t seed = n * 2654435761u;
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      uint8_t pixel = (x / 4 + y / 2) & 0xFC;
+      if (x > n * 3 && x < n * 3 + 20 && y > 40 && y < 70) {
+        pixel = 200;
+      }
+      if ((x & 7) == 0) {
+        seed = seed * 1103515245u + 12345u;
+        pixel += (seed >> 16) & 3;
+      }
+      plane[y * width + x] = pixel;
+    }
+  }
+}
+
+int fillLog(int n) {
+  int bytes = 0;
+  for (int line = 0; line < 200; line++) {
+    bytes += snprintf((char*)plane + bytes, planeSize - bytes, "t=%d frame=%d temp=21.%d motion=%d\n",
+                      n * 1000 + line * 5, n, line % 10, line % 17 == 0);
+  }
+  return bytes;
+}
+
+bool checkFile(int id, uint32_t bytes) {
+  String fileName;
+  return himem.readFile(id, fileName, readBuf) == bytes && memcmp(readBuf, plane, bytes) == 0;
+}
+
+/* chunk sink for readFile(), the data arrives decompressed */
+struct VerifyState {
+  uint32_t offset;
+  bool match;
+};
+
+bool verifyChunk(const uint8_t* data, uint32_t bytes, void* context) {
+  VerifyState* state = (VerifyState*)context;
+  if (state->offset + bytes > planeSize || memcmp(data, plane + state->offset, bytes) != 0) {
+    state->match = false;
+    return false;
+  }
+  state->offset += bytes;
+  return true;
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+  ESP_LOGI("setup", "Start");
+
+  himem.create(2);
+  bool match = true;
+
+/* the same planes stored raw and compressed */
+  unsigned long rawTime = 0;
+  unsigned long packedTime = 0;
+  uint32_t packedBytes = 0;
+  for (int n = 0; n < frames; n++) {
+    fillPlane(n);
+    unsigned long start = micros();
+    int rawID = himem.writeFile(0, "raw_" + String(n) + ".gray", plane, planeSize);
+    rawTime += micros() - start;
+    start = micros();
+    int id = himem.writeFile(0, "plane_" + String(n) + ".gray", plane, planeSize, true);
+    packedTime += micros() - start;
+    if (rawID < 0 || id < 0) {
+      ESP_LOGE("setup", "Failed to write plane %d", n);
+      stop;
+    }
+    packedBytes += himem.getStoredSize(id);
+    match = match && checkFile(id, planeSize) && himem.getFilesize(id) == planeSize;
+  }
+  Serial.printf("%d planes of %d bytes: %u bytes compressed, ratio %.2f\n",
+    frames, planeSize, packedBytes, (float)frames * planeSize / packedBytes);
+  Serial.printf("Write time per plane: raw %lu us, compressed %lu us\n", rawTime / frames, packedTime / frames);
+
+/* logs and data that does not compress */
+  int logBytes = fillLog(1);
+  int logID = himem.writeFile(0, "log_1.txt", plane, logBytes, true);
+  Serial.printf("Log of %d bytes stored in %u bytes\n", logBytes, himem.getStoredSize(logID));
+  match = match && checkFile(logID, logBytes);
+  uint32_t seed = 1;
+  for (int j = 0; j < planeSize; j++) {
+    seed = seed * 1103515245u + 12345u;
+    plane[j] = seed >> 24;
+  }
+  int noiseID = himem.writeFile(0, "noise.bin", plane, planeSize, true);
+  match = match && checkFile(noiseID, planeSize) &&
+          himem.getStoredSize(noiseID) == HIMEM_LZ_BOUND(planeSize);
+
+/* a compressed file written into a hole hands the unused part of the hole back */
+  himem.deleteFile(0);
+  himem.deleteFile(1);
+  unsigned long before = himem.freespace();
+  fillPlane(7);
+  int holeID = himem.writeFile(0, "hole.gray", plane, planeSize, true);
+  VerifyState state = {0, true};
+  match = match && himem.readFile(holeID, verifyChunk, &state) == planeSize && state.match;
+  match = match && before - himem.freespace() == himem.getStoredSize(holeID);
+
+/* FIFO of compressed planes, files wrap around the end of HIMEM */
+  himem.destroy();
+  himem.create(2);
+  himem.setFifoMode(true);
+  int written = 0;
+  unsigned long capacity = himem.freespace();
+  while ((unsigned long)written * planeSize < 4 * capacity) {
+    fillPlane(written % 50);
+    if (himem.writeFile(0, "fifo_" + String(written) + ".gray", plane, planeSize, true) < 0) {
+      ESP_LOGE("setup", "Failed to write FIFO plane %d", written);
+      stop;
+    }
+    written++;
+  }
+  for (int id = himem.getOldestID(); id <= himem.getNewestID(); id++) {
+    fillPlane(id % 50);
+    match = match && checkFile(id, planeSize);
+  }
+  Serial.printf("FIFO of %lu bytes holds %d compressed planes of %d written\n",
+    capacity, himem.getFileCount(), written);
+
+  if (match) {
+    Serial.println("Compression verification successful");
+  }
+}
+
+void loop() {
+}
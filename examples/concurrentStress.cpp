@@ -0,0 +1,172 @@
+#include "HIMEM.h"
+
+/* -----------------------------------------------------------
+* Concurrent mode stress test
+* A capture task on core 1 writes frames of varying size as fast as
+* it can, some with writeFile() and some in pieces with appendFile(),
+* while a drain task on core 0 reads, checks and releases them. The
+* store is small compared to the data written so it is full most of
+* the time and the ring wraps many times.
+* On the host build this runs as the concurrentStress ctest.
+----------------------------------------------------------------*/
+
+HIMEMLIB::HIMEM himem;
+
+#define stop {delay(1000); while(1);}
+#define maxFrameSize 60000
+#define framesToWrite 2000
+#define pieceSize 3000
+
+uint8_t writeBuf[maxFrameSize];
+uint8_t readBuf[maxFrameSize];
+
+SemaphoreHandle_t writerDone;
+SemaphoreHandle_t readerDone;
+volatile bool failed = false;
+volatile uint32_t writerWaits = 0;
+
+/* frame size and content depend on the frame number so stale or torn data is detected */
+uint32_t frameBytes(uint32_t frame) {
+  return 1000 + (frame * 7717) % (maxFrameSize - 1000);
+}
+
+uint8_t frameByte(uint32_t frame, uint32_t i) {
+  return (uint8_t)(i * 31 + frame);
+}
+
+/* writer waits for the reader to release space instead of dropping frames */
+bool storeFull(int ret) {
+  if (ret == static_cast<int>(HIMEMLIB::HimemError::INSUFFICIENT_MEMORY) ||
+      ret == static_cast<int>(HIMEMLIB::HimemError::MAX_HIMEM_FILES_REACHED)) {
+    writerWaits++;
+    vTaskDelay(1);
+    return !failed;
+  }
+  return false;
+}
+
+void writerTask(void* param) {
+  (void)param;
+  for (uint32_t frame = 0; frame < framesToWrite && !failed; frame++) {
+    uint32_t bytes = frameBytes(frame);
+    for (uint32_t i = 0; i < bytes; i++) {
+      writeBuf[i] = frameByte(frame, i);
+    }
+    String fileName = "frame_" + String(frame) + ".jpg";
+    int id;
+    if (frame % 4 != 3) {
+      while (storeFull(id = himem.writeFile(0, fileName, writeBuf, bytes))) {}
+    } else {
+      while (storeFull(id = himem.openFile(fileName))) {}
+      for (uint32_t offset = 0; offset < bytes && id >= 0; offset += pieceSize) {
+        uint32_t piece = (bytes - offset < pieceSize) ? bytes - offset : pieceSize;
+        int ret;
+        while (storeFull(ret = himem.appendFile(id, writeBuf + offset, piece))) {}
+        if (ret < 0) id = ret;
+      }
+      if (id >= 0) id = himem.closeFile(id);
+    }
+    if (id != (int)frame) {
+      ESP_LOGE("writer", "Frame %u was stored as ID %d", frame, id);
+      failed = true;
+    }
+  }
+  xSemaphoreGive(writerDone);
+  vTaskDelete(NULL);
+}
+
+/* chunk sink for readFile(), runs without the window lock held */
+struct VerifyState {
+  uint32_t frame;
+  uint32_t offset;
+};
+
+bool verifyChunk(const uint8_t* data, uint32_t bytes, void* context) {
+  VerifyState* state = (VerifyState*)context;
+  for (uint32_t j = 0; j < bytes; j++) {
+    if (data[j] != frameByte(state->frame, state->offset + j)) {
+      return false;
+    }
+  }
+  state->offset += bytes;
+  return true;
+}
+
+bool checkFrame(uint32_t frame) {
+  uint32_t bytes = frameBytes(frame);
+  String fileName = "frame_" + String(frame) + ".jpg";
+  if (himem.getFilesize(frame) != bytes || himem.getID(fileName) != (int)frame) {
+    return false;
+  }
+  if (frame % 2 == 0) {
+    String readName;
+    if (himem.readFile(frame, readName, readBuf) != bytes || readName != fileName) {
+      return false;
+    }
+    for (uint32_t i = 0; i < bytes; i++) {
+      if (readBuf[i] != frameByte(frame, i)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  VerifyState state = {frame, 0};
+  return himem.readFile(frame, verifyChunk, &state) == bytes;
+}
+
+void readerTask(void* param) {
+  (void)param;
+  uint32_t frame = 0;
+  while (frame < framesToWrite && !failed) {
+    int id = himem.getOldestID();
+    if (id < 0) {
+      vTaskDelay(1);
+      continue;
+    }
+    if (id != (int)frame || !checkFrame(frame)) {
+      ESP_LOGE("reader", "Frame %u (oldest ID %d) failed verification", frame, id);
+      failed = true;
+      break;
+    }
+    if (himem.releaseFile(id) < 0) {
+      failed = true;
+      break;
+    }
+    frame++;
+    if (frame % 256 == 0) {
+      vTaskDelay(pdMS_TO_TICKS(20));                   // fall behind so the writer finds the store full
+    }
+  }
+  xSemaphoreGive(readerDone);
+  vTaskDelete(NULL);
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+  ESP_LOGI("setup", "Start");
+
+  himem.create(2);
+  if (himem.setConcurrentMode(true) < 0) {
+    ESP_LOGE("setup", "Could not select concurrent mode");
+    stop;
+  }
+  writerDone = xSemaphoreCreateBinary();
+  readerDone = xSemaphoreCreateBinary();
+
+  unsigned long start = millis();
+  xTaskCreatePinnedToCore(readerTask, "reader", 4096, NULL, 1, NULL, 0);
+  xTaskCreatePinnedToCore(writerTask, "writer", 4096, NULL, 2, NULL, 1);
+  bool finished = xSemaphoreTake(writerDone, pdMS_TO_TICKS(120000)) == pdTRUE &&
+                  xSemaphoreTake(readerDone, pdMS_TO_TICKS(120000)) == pdTRUE;
+
+  HIMEMLIB::HimemMapStats stats = himem.getMapStats();
+  Serial.printf("%d frames in %lu ms, writer waited %u times, %u bank switches\n",
+    framesToWrite, millis() - start, writerWaits, stats.maps);
+  if (finished && !failed && himem.getFileCount() == 0) {
+    Serial.println("Concurrent verification successful");
+  }
+}
+
+void loop() {
+}
@@ -0,0 +1,149 @@
+#include "HIMEM.h"
+
+/* -----------------------------------------------------------
+* Delete and compaction example
+* Frames that turn out to contain no motion are deleted as soon as
+* they have been compared with the frames after them. New frames reuse the holes they leave and
+* compactStep(), called from the capture loop, slides the kept frames
+* down so the free space ends up in one piece again.
+----------------------------------------------------------------*/
+
+HIMEMLIB::HIMEM himem;
+
+#define stop {delay(1000); while(1);}
+#define maxFrameSize 40000
+#define frames 120
+#define lookahead 4                         // frames needed to decide on motion
+
+uint8_t frameBuf[maxFrameSize];
+bool kept[frames * 2];
+
+uint32_t frameBytes(int frame) {
+  return 5000 + (frame * 7919) % (maxFrameSize - 5000);
+}
+
+/* stand in for motion detection, keeps about one frame in three */
+bool hasMotion(int frame) {
+  return frame % 3 == 0 || frame % 7 == 0;
+}
+
+int writeFrame(int frame) {
+  uint32_t bytes = frameBytes(frame);
+  for (uint32_t j = 0; j < bytes; j++) {
+    frameBuf[j] = (uint8_t)(j * 13 + frame);
+  }
+  String fileName = "frame_" + String(frame) + ".jpg";
+  return himem.writeFile(0, fileName, frameBuf, bytes);
+}
+
+bool checkFrame(int id, int frame) {
+  String fileName;
+  uint32_t bytes = himem.readFile(id, fileName, frameBuf);
+  if (bytes != frameBytes(frame) || fileName != "frame_" + String(frame) + ".jpg") {
+    return false;
+  }
+  for (uint32_t j = 0; j < bytes; j++) {
+    if (frameBuf[j] != (uint8_t)(j * 13 + frame)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool checkKept(int count) {
+  for (int i = 0; i < count; i++) {
+    if (kept[i] && !checkFrame(i, i)) {
+      ESP_LOGE("check", "Frame %d failed verification", i);
+      return false;
+    }
+  }
+  return true;
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+  ESP_LOGI("setup", "Start");
+
+  himem.create();
+
+/* capture, dropping frames without motion once they have been checked */
+  for (int i = 0; i < frames; i++) {
+    if (writeFrame(i) != i) {
+      ESP_LOGE("setup", "Failed to write frame %d", i);
+      stop;
+    }
+    int check = i - lookahead;
+    kept[i] = true;
+    if (check >= 0 && !hasMotion(check)) {
+      kept[check] = false;
+      if (himem.deleteFile(check) < 0) {
+        ESP_LOGE("setup", "Failed to delete frame %d", check);
+        stop;
+      }
+    }
+  }
+  Serial.printf("Kept %d of %d frames, %d%% of the free space is in holes\n",
+    himem.getFileCount(), frames, himem.getFragmentation());
+
+/* new frames fill the holes first, compaction runs a bank at a time in between */
+  himem.resetMapStats();
+  uint32_t moved = 0;
+  for (int i = frames; i < frames * 2; i++) {
+    if (writeFrame(i) != i) {
+      ESP_LOGE("setup", "Failed to write frame %d", i);
+      stop;
+    }
+    int check = i - lookahead;
+    kept[i] = true;
+    if (!hasMotion(check)) {
+      kept[check] = false;
+      himem.deleteFile(check);
+    }
+    moved += himem.compactStep();
+  }
+  bool match = checkKept(frames * 2);
+
+/* compact what is left, frames stay readable while they are part way moved */
+  himem.setCompactThreshold(0);
+  uint32_t step;
+  while ((step = himem.compactStep()) > 0) {
+    moved += step;
+    match = match && checkKept(frames * 2);
+  }
+  HIMEMLIB::HimemMapStats stats = himem.getMapStats();
+  Serial.printf("Compaction moved %u bytes with %u bank switches, %d%% fragmentation left\n",
+    moved, stats.maps, himem.getFragmentation());
+
+  match = match && checkKept(frames * 2) && himem.getFragmentation() == 0 &&
+          himem.getFileName(0) == "frame_0.jpg" && himem.getFilesize(1) == 0;
+
+/* a second file with a name already stored is found by it once the first is deleted */
+  int first = himem.writeFile(0, "same.jpg", frameBuf, 1000);
+  int second = himem.writeFile(0, "same.jpg", frameBuf, 2000);
+  match = match && first >= 0 && second >= 0 && himem.getID("same.jpg") == first;
+  match = match && himem.deleteFile(first) == 0 && himem.getID("same.jpg") == second && himem.getFilesize(second) == 2000;
+  match = match && himem.deleteFile(second) == 0 && himem.getID("same.jpg") == -1;
+
+/* deleting the oldest files frees their records, so writing never runs out of file IDs */
+  himem.freeMemory();
+  int failedWrites = 0;
+  for (int i = 0; i < MAX_HIMEM_FILES + 1000; i++) {
+    if (himem.writeFile(0, "clip_" + String(i) + ".jpg", frameBuf, 500) != i) {
+      failedWrites++;
+    }
+    if (i >= lookahead) {
+      himem.deleteFile(i - lookahead);
+    }
+  }
+  Serial.printf("Wrote and deleted %d files, %d writes failed\n", MAX_HIMEM_FILES + 1000, failedWrites);
+  match = match && failedWrites == 0 && himem.getFileCount() == lookahead &&
+          himem.getOldestID() == MAX_HIMEM_FILES + 1000 - lookahead;
+
+  if (match) {
+    Serial.println("Delete verification successful");
+  }
+}
+
+void loop() {
+}
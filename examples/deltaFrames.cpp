@@ -0,0 +1,122 @@
+#include "HIMEM.h"
+
+/* -----------------------------------------------------------
+* Delta frames example
+* A fixed camera sees the same scene frame after frame, only a small
+* object moves. writeDelta() stores each frame as the runs that differ
+* from a baseline slot, so many more frames fit before the store is
+* full and far fewer bytes go through the map window per frame.
+* readFile() rebuilds the full frame.
+----------------------------------------------------------------*/
+
+HIMEMLIB::HIMEM himem;
+
+#define stop {delay(1000); while(1);}
+#define width 320
+#define height 240
+#define frameSize (width * height)
+
+uint8_t frame[frameSize];
+uint8_t readBuf[frameSize];
+
+/* a gray scene with an object that moves a few pixels every frame */
+void fillFrame(int n) {
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      frame[y * width + x] = (uint8_t)(x / 2 + y);
+    }
+  }
+  if (n < 0) {
+    return;                                 // the empty scene used as baseline
+  }
+  int left = (n * 3) % (width - 24);
+  for (int y = 100; y < 130; y++) {
+    for (int x = left; x < left + 24; x++) {
+      frame[y * width + x] = (uint8_t)(200 + n);
+    }
+  }
+}
+
+bool checkFrame(int id, int n) {
+  String fileName;
+  fillFrame(n);
+  return himem.readFile(id, fileName, readBuf) == frameSize && memcmp(readBuf, frame, frameSize) == 0;
+}
+
+/* chunk sink for readFile(), delta frames are rebuilt a piece at a time */
+struct VerifyState {
+  uint32_t offset;
+  bool match;
+};
+
+bool verifyChunk(const uint8_t* data, uint32_t bytes, void* context) {
+  VerifyState* state = (VerifyState*)context;
+  if (state->offset + bytes > frameSize || memcmp(data, frame + state->offset, bytes) != 0) {
+    state->match = false;
+    return false;
+  }
+  state->offset += bytes;
+  return true;
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+  ESP_LOGI("setup", "Start");
+
+  himem.create(2, 4, 3);                    // baseline slots of 3 banks for the 76800 byte frames
+  fillFrame(-1);
+  if (himem.writeBaseline(0, "scene.gray", frame, frameSize) < 0) {
+    stop;
+  }
+
+/* full frames until the store is full */
+  int rawFrames = 0;
+  unsigned long start = micros();
+  while (true) {
+    fillFrame(rawFrames);
+    if (himem.writeFile(0, "frame_" + String(rawFrames) + ".gray", frame, frameSize) < 0) {
+      break;
+    }
+    rawFrames++;
+  }
+  unsigned long rawTime = (micros() - start) / rawFrames;
+
+/* the same frames as deltas */
+  himem.freeMemory();
+  int deltaFrames = 0;
+  unsigned long deltaTime = 0;
+  while (true) {
+    fillFrame(deltaFrames);
+    start = micros();
+    int id = himem.writeDelta(0, "frame_" + String(deltaFrames) + ".gray", frame, frameSize);
+    if (id < 0) {
+      break;
+    }
+    deltaTime += micros() - start;
+    deltaFrames++;
+  }
+  Serial.printf("Frames until full: %d written with writeFile(), %d with writeDelta()\n", rawFrames, deltaFrames);
+  Serial.printf("Write time per frame: writeFile %lu us, writeDelta %lu us, delta frame uses %u bytes\n",
+    rawTime, deltaTime / deltaFrames, himem.getStoredSize(1));
+
+  bool match = deltaFrames > rawFrames;
+  for (int id = 0; id < deltaFrames; id++) {
+    match = match && checkFrame(id, id) && himem.getFilesize(id) == frameSize;
+  }
+  VerifyState state = {0, true};
+  fillFrame(5);
+  match = match && himem.readFile(5, verifyChunk, &state) == frameSize && state.match;
+
+/* a new baseline in the slot makes the old deltas unreadable rather than wrong */
+  fillFrame(-1);
+  himem.writeBaseline(0, "scene2.gray", frame, frameSize);
+  match = match && himem.readFile(5, verifyChunk, &state) == 0;
+
+  if (match) {
+    Serial.println("Delta verification successful");
+  }
+}
+
+void loop() {
+}
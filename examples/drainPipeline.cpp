@@ -0,0 +1,161 @@
+#include "HIMEM.h"
+#include "HimemDrain.h"
+#include <sys/stat.h>
+
+/* -----------------------------------------------------------
+* Drain pipeline example
+* Dumps a motion event (a burst of frames) to storage twice: first
+* the simple way, reading one file and then writing it, and then
+* with HimemDrain, which reads the next chunk out of HIMEM while the
+* previous one is being written. The drained files are released as
+* they are written and checked on the card afterwards.
+* On the host build the SD card is a directory written at a
+* throttled SD card like speed.
+----------------------------------------------------------------*/
+
+#ifdef DRAIN_DIR
+#define SD_BYTES_PER_MS 2000                // emulated SD write speed, 2 MB/s
+#else
+#include "SD_MMC.h"
+#define DRAIN_DIR "/sdcard"
+#define SD_MMC_D0          2                 //Hardwired to SD card
+#define SD_MMC_CLK        14                 //Hardwired to SD card
+#define SD_MMC_CMD        15                 //Hardwired to SD card
+#endif
+
+HIMEMLIB::HIMEM himem;
+
+#define stop {delay(1000); while(1);}
+#define frameSize 30000
+#define frames 40
+
+uint8_t frameBuf[frameSize];
+
+/* sink wrapper that takes as long as an SD card would */
+class ThrottledSink : public HIMEMLIB::HimemSink {
+public:
+  ThrottledSink(HIMEMLIB::HimemSink& sink) : sink(sink) {}
+  bool open(const char* name, uint32_t size) override { return sink.open(name, size); }
+  bool write(const uint8_t* data, uint32_t bytes) override {
+#ifdef SD_BYTES_PER_MS
+    delayMicroseconds((uint64_t)bytes * 1000 / SD_BYTES_PER_MS);
+#endif
+    return sink.write(data, bytes);
+  }
+  bool close(bool complete) override { return sink.close(complete); }
+
+private:
+  HIMEMLIB::HimemSink& sink;
+};
+
+HIMEMLIB::HimemDirSink dirSink(DRAIN_DIR);
+ThrottledSink sdSink(dirSink);
+HIMEMLIB::HimemDrain drainer(himem, sdSink);
+
+volatile int filesDone = 0;
+
+void fileDone(int id, bool ok, void* context) {
+  (void)context;
+  if (!ok) {
+    ESP_LOGE("drain", "File %d was not written", id);
+  }
+  filesDone++;
+}
+
+void writeEvent(int event) {
+  for (int i = 0; i < frames; i++) {
+    for (int j = 0; j < frameSize; j++) {
+      frameBuf[j] = (uint8_t)(j + i + event);
+    }
+    String fileName = "event" + String(event) + "_" + String(i) + ".jpg";
+    if (himem.writeFile(0, fileName, frameBuf, frameSize) < 0) {
+      ESP_LOGE("setup", "Failed to write %s", fileName.c_str());
+      stop;
+    }
+  }
+}
+
+bool checkEvent(int event) {
+  for (int i = 0; i < frames; i++) {
+    String path = String(DRAIN_DIR) + "/event" + String(event) + "_" + String(i) + ".jpg";
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+      return false;
+    }
+    size_t n = fread(frameBuf, 1, frameSize, file);
+    fclose(file);
+    if (n != frameSize) {
+      return false;
+    }
+    for (int j = 0; j < frameSize; j++) {
+      if (frameBuf[j] != (uint8_t)(j + i + event)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+  ESP_LOGI("setup", "Start");
+
+#ifndef SD_BYTES_PER_MS
+  SD_MMC.setPins(SD_MMC_CLK, SD_MMC_CMD, SD_MMC_D0);
+  if (!SD_MMC.begin(DRAIN_DIR, true, true, SDMMC_FREQ_DEFAULT, 5)) {
+    ESP_LOGE("SD", "Micro SD Card Mount Failed #####");
+    stop;
+  }
+#else
+  mkdir(DRAIN_DIR, 0777);
+#endif
+
+/* the drain tasks read and release files while this task keeps writing */
+  himem.create(2);
+  himem.setConcurrentMode(true);
+
+/* event 0, read a file then write it */
+  writeEvent(0);
+  unsigned long start = millis();
+  for (int id = himem.getOldestID(); id >= 0 && id <= himem.getNewestID(); id = himem.getOldestID()) {
+    String fileName;
+    uint32_t bytes = himem.readFile(id, fileName, frameBuf);
+    bool ok = bytes > 0 && sdSink.open(fileName.c_str(), bytes);
+    if (ok) {
+      bool written = sdSink.write(frameBuf, bytes);
+      ok = sdSink.close(written) && written;
+    }
+    if (!ok) {
+      ESP_LOGE("setup", "Failed to write file %d", id);
+      stop;
+    }
+    himem.releaseFile(id);
+  }
+  unsigned long serialMs = millis() - start;
+
+/* event 1, drain pipeline */
+  if (drainer.begin() < 0) {
+    stop;
+  }
+  drainer.onFileDone(fileDone, nullptr);
+  writeEvent(1);
+  start = millis();
+  drainer.drain(himem.getOldestID(), himem.getNewestID(), true);
+  drainer.waitIdle();
+  unsigned long pipelineMs = millis() - start;
+  HIMEMLIB::HimemDrainStats stats = drainer.getStats();
+  drainer.end();
+
+  uint32_t eventBytes = frames * frameSize;
+  Serial.printf("Event of %u bytes: read then write %lu ms, pipeline %lu ms (sink busy %u ms, HIMEM reads %u ms)\n",
+    eventBytes, serialMs, pipelineMs, stats.sinkMicros / 1000, stats.readMicros / 1000);
+  Serial.printf("Drained %u files, %u failed, read task waited for the sink %u times\n",
+    stats.files, stats.failures, stats.bufferWaits);
+  if (checkEvent(0) && checkEvent(1) && stats.files == frames && filesDone == frames && himem.getFileCount() == 0) {
+    Serial.println("Drain verification successful");
+  }
+}
+
+void loop() {
+}
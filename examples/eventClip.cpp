@@ -0,0 +1,101 @@
+#include "HIMEM.h"
+
+/* -----------------------------------------------------------
+* Event clip example
+* A camera keeps a FIFO of frames. When motion is detected the frames
+* from the seconds before the trigger are wanted, e.g. to write a clip
+* to the SD card. Every file gets its write time, so getIDs() finds
+* them with a binary search instead of encoding times in filenames and
+* walking the records. setTag() marks the frames written during the
+* event so they can be picked out of the same range.
+----------------------------------------------------------------*/
+
+HIMEMLIB::HIMEM himem;
+
+#define stop {delay(1000); while(1);}
+#define frameSize 3000
+#define frames 600
+#define frameInterval 5                     // ms between frames
+#define preTrigger 400                      // ms of frames kept before the trigger
+#define eventTag 1
+#define maxClip 200
+
+uint8_t frame[frameSize];
+int clip[maxClip];
+
+uint32_t frameBytes(int n) {
+  return 1000 + (n * 211) % (frameSize - 1000);
+}
+
+/* the IDs a linear walk of every stored file finds */
+int walkRange(uint32_t from, uint32_t to, int tag, int* ids) {
+  int found = 0;
+  for (int id = himem.getOldestID(); id >= 0 && id <= himem.getNewestID(); id++) {
+    uint32_t time = himem.getTimestamp(id);
+    if (time >= from && time <= to && (tag < 0 || himem.getTag(id) == tag) && found < maxClip) {
+      ids[found++] = id;
+    }
+  }
+  return found;
+}
+
+bool sameIDs(const int* a, int countA, const int* b, int countB) {
+  return countA == countB && memcmp(a, b, countA * sizeof(int)) == 0;
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+  ESP_LOGI("setup", "Start");
+
+  himem.create();
+  himem.setFifoMode(true);
+
+/* capture, with motion from frame 400 to 450 */
+  uint32_t trigger = 0;
+  for (int n = 0; n < frames; n++) {
+    if (n == 400) {
+      trigger = millis();
+      himem.setTag(eventTag);
+    }
+    if (n == 450) {
+      himem.setTag(0);
+    }
+    memset(frame, (uint8_t)n, frameBytes(n));
+    if (himem.writeFile(0, "frame_" + String(n) + ".jpg", frame, frameBytes(n)) != n) {
+      ESP_LOGE("setup", "Failed to write frame %d", n);
+      stop;
+    }
+    delay(frameInterval);
+  }
+
+/* the clip: frames from preTrigger ms before the trigger until the trigger */
+  unsigned long start = micros();
+  int count = himem.getIDs(trigger - preTrigger, trigger, clip, maxClip);
+  unsigned long search = micros() - start;
+  int expected[maxClip];
+  start = micros();
+  int expectedCount = walkRange(trigger - preTrigger, trigger, -1, expected);
+  unsigned long walk = micros() - start;
+  Serial.printf("Clip of %d frames, IDs %d to %d: getIDs %lu us, walking the records %lu us\n",
+    count, count ? clip[0] : -1, count ? clip[count - 1] : -1, search, walk);
+  bool match = count > 0 && sameIDs(clip, count, expected, expectedCount);
+
+/* the event frames out of everything stored */
+  count = himem.getIDs(0, millis(), clip, maxClip, eventTag);
+  expectedCount = walkRange(0, millis(), eventTag, expected);
+  match = match && count == 50 && clip[0] == 400 && sameIDs(clip, count, expected, expectedCount);
+
+/* a deleted frame is left out, an empty range finds nothing */
+  match = match && himem.deleteFile(420) == 0;
+  count = himem.getIDs(0, millis(), clip, maxClip, eventTag);
+  match = match && count == 49 && clip[20] == 421;
+  match = match && himem.getIDs(trigger, trigger - 1, clip, maxClip) == 0;
+
+  if (match) {
+    Serial.println("Event clip verification successful");
+  }
+}
+
+void loop() {
+}
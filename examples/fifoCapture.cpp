@@ -0,0 +1,83 @@
+#include "HIMEM.h"
+
+/* -----------------------------------------------------------
+* Continuous capture with the store in FIFO mode
+* Frames of varying size are written forever, the oldest frames
+* are dropped automatically and the pre-motion history is read
+* back from getOldestID() to getNewestID().
+----------------------------------------------------------------*/
+
+HIMEMLIB::HIMEM himem;
+
+#define stop {delay(1000); while(1);}
+#define maxFrameSize 40000
+#define framesToWrite 3000
+
+uint8_t frameBuf[maxFrameSize];
+
+/* frame content depends on the frame number so stale data is detected */
+uint32_t fillFrame(uint32_t frame) {
+  uint32_t bytes = 5000 + (frame * 7717) % (maxFrameSize - 5000);
+  for (uint32_t i = 0; i < bytes; i++) {
+    frameBuf[i] = (uint8_t)(i + frame);
+  }
+  return bytes;
+}
+
+bool checkFrame(uint32_t frame, uint32_t bytes) {
+  if (bytes != 5000 + (frame * 7717) % (maxFrameSize - 5000)) {
+    return false;
+  }
+  for (uint32_t i = 0; i < bytes; i++) {
+    if (frameBuf[i] != (uint8_t)(i + frame)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+  ESP_LOGI("setup", "Start");
+
+  himem.create();
+  himem.setFifoMode(true);
+
+/* capture continuously, the store never fills up */
+  for (uint32_t frame = 0; frame < framesToWrite; frame++) {
+    uint32_t bytes = fillFrame(frame);
+    String fileName = "frame_" + String(frame) + ".jpg";
+    int id = himem.writeFile(0, fileName, frameBuf, bytes);
+    if (id != (int)frame) {
+      ESP_LOGE("setup", "Frame %u was stored as ID %d", frame, id);
+      stop;
+    }
+  }
+  Serial.printf("Wrote %d frames, holding IDs %d to %d (%d files, %lu bytes free)\n", framesToWrite,
+    himem.getOldestID(), himem.getNewestID(), himem.getFileCount(), himem.freespace());
+
+/* read back the history that is still stored */
+  bool match = true;
+  for (int id = himem.getOldestID(); id <= himem.getNewestID(); id++) {
+    String fileName;
+    uint32_t bytes = himem.readFile(id, fileName, frameBuf);
+    if (!checkFrame(id, bytes) || himem.getID(fileName) != id) {
+      ESP_LOGE("setup", "Frame %d (%s) failed verification", id, fileName.c_str());
+      match = false;
+      break;
+    }
+  }
+  String fileName;
+  if (himem.readFile(himem.getOldestID() - 1, fileName, frameBuf) != 0) {
+    ESP_LOGE("setup", "Retired frame %d is still readable", himem.getOldestID() - 1);
+    match = false;
+  }
+  if (match) {
+    Serial.println("FIFO verification successful");
+  }
+  himem.printMemoryStatus();
+}
+
+void loop() {
+}
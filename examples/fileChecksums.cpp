@@ -0,0 +1,126 @@
+#include "HIMEM.h"
+
+/* -----------------------------------------------------------
+* File checksums example
+* With setChecksums(true) every file gets a CRC-32, taken while the
+* data is copied into the map window, and readFile() checks it while
+* copying the file out again. A PSRAM bit flip or a file overwritten
+* behind the library's back is reported instead of handed on as a
+* frame. verifyFile() checks a file without reading it into a buffer.
+* The cost of the checksums is timed against plain reads and writes.
+----------------------------------------------------------------*/
+
+HIMEMLIB::HIMEM himem;
+
+#define stop {delay(1000); while(1);}
+#define frameSize 30000
+#define frames 60
+
+uint8_t frame[frameSize];
+uint8_t readBuf[frameSize];
+
+uint32_t frameBytes(int n) {
+  return 10000 + (n * 4007) % (frameSize - 10000);
+}
+
+void fillFrame(int n) {
+  for (uint32_t i = 0; i < frameBytes(n); i++) {
+    frame[i] = (uint8_t)((i / 64) * 3 + n);
+  }
+}
+
+/* write the frames and read them back, return false on a failed or wrong read */
+bool timeFrames(unsigned long& writeTime, unsigned long& readTime) {
+  himem.freeMemory();
+  writeTime = 0;
+  readTime = 0;
+  for (int n = 0; n < frames; n++) {
+    fillFrame(n);
+    unsigned long start = micros();
+    if (himem.writeFile(0, "frame_" + String(n) + ".raw", frame, frameBytes(n)) != n) {
+      return false;
+    }
+    writeTime += micros() - start;
+  }
+  for (int n = 0; n < frames; n++) {
+    String fileName;
+    unsigned long start = micros();
+    uint32_t bytes = himem.readFile(n, fileName, readBuf);
+    readTime += micros() - start;
+    fillFrame(n);
+    if (bytes != frameBytes(n) || memcmp(readBuf, frame, bytes) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool countChunk(const uint8_t*, uint32_t bytes, void* context) {
+  *(uint32_t*)context += bytes;
+  return true;
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+  ESP_LOGI("setup", "Start");
+
+  himem.create();
+
+/* plain and checksummed reads and writes, the first pass warms up */
+  unsigned long plainWrite = 0, plainRead = 0, crcWrite = 0, crcRead = 0;
+  bool match = timeFrames(plainWrite, plainRead) && timeFrames(plainWrite, plainRead);
+  himem.setChecksums(true);
+  match = match && timeFrames(crcWrite, crcRead);
+  Serial.printf("Per frame: write %lu us, with checksum %lu us; read %lu us, with checksum %lu us\n",
+    plainWrite / frames, crcWrite / frames, plainRead / frames, crcRead / frames);
+  for (int n = 0; n < frames && match; n++) {
+    match = himem.verifyFile(n) == 0;
+  }
+
+/* every way of writing a file gets a checksum */
+  fillFrame(99);
+  int compressed = himem.writeFile(0, "compressed.raw", frame, frameBytes(99), true);
+  match = match && himem.writeBaseline(0, "baseline.raw", frame, frameBytes(99)) >= 0;
+  frame[500] ^= 0xFF;
+  int delta = himem.writeDelta(0, "delta.raw", frame, frameBytes(99));
+  int streamed = himem.openFile("streamed.raw");
+  match = match && himem.appendFile(streamed, frame, 1000) == 0 &&
+          himem.appendFile(streamed, frame + 1000, frameBytes(99) - 1000) == 0 && himem.closeFile(streamed) == streamed;
+  HIMEMLIB::HimemBatchEntry batch[2] = {{"burst_0.raw", frame, 5000}, {"burst_1.raw", frame + 5000, 7000}};
+  int burst = himem.writeFiles(batch, 2);
+  for (int id : {compressed, delta, streamed, burst, burst + 1}) {
+    match = match && id >= 0 && himem.verifyFile(id) == 0;
+  }
+  String fileName;
+  match = match && himem.readFile(delta, fileName, readBuf) == frameBytes(99) && memcmp(readBuf, frame, frameBytes(99)) == 0;
+
+/* a stray write into HIMEM, e.g. through a view pointer, is caught */
+  int hit = 10;
+  {
+    HIMEMLIB::HimemView view = himem.viewFile(hit);
+    match = match && view.valid();
+    if (view.valid()) {
+      ((uint8_t*)view.data())[1234] ^= 0x04;
+    }
+  }
+  uint8_t header[100];
+  uint32_t streamedBytes = 0;
+  HIMEMLIB::HimemSegment parts[2] = {{header, sizeof(header)}, {readBuf, frameSize}};
+  match = match && himem.verifyFile(hit) == static_cast<int>(HIMEMLIB::HimemError::CHECKSUM_MISMATCH) &&
+          himem.readFile(hit, fileName, readBuf) == 0 && himem.readFile(hit, fileName, parts, 2) == 0 &&
+          himem.readFile(hit, countChunk, &streamedBytes) == 0 && himem.verifyFile(hit + 1) == 0;
+
+/* files written with checksums off have none */
+  himem.setChecksums(false);
+  int plain = himem.writeFile(0, "plain.raw", frame, 1000);
+  match = match && himem.verifyFile(plain) == static_cast<int>(HIMEMLIB::HimemError::INVALID_ID) &&
+          himem.readFile(plain, fileName, readBuf) == 1000;
+
+  if (match) {
+    Serial.println("Checksum verification successful");
+  }
+}
+
+void loop() {
+}
@@ -0,0 +1,66 @@
+#include "HIMEM.h"
+
+/* -----------------------------------------------------------
+* Boot memory test example
+* memoryTest() walks every bank of the store with walking ones,
+* address-in-address and pseudo random patterns, reports bad words per
+* bank and measures map latency and sequential/strided read and write
+* rates. It takes a second or two, so it can run at every boot before
+* the camera starts; the result is logged as one line and can be sent
+* on as is. The test erases the store, which is then used as normal.
+----------------------------------------------------------------*/
+
+HIMEMLIB::HIMEM himem;
+
+#define stop {delay(1000); while(1);}
+#define maxBanks 256
+#define frameSize 20000
+
+uint16_t bankErrors[maxBanks];
+uint8_t frame[frameSize];
+uint8_t readBuf[frameSize];
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+  ESP_LOGI("setup", "Start");
+
+  himem.create();
+  unsigned long empty = himem.freespace();
+
+/* something stored before the test, it does not survive it */
+  memset(frame, 0x5A, frameSize);
+  himem.writeFile(0, "before.raw", frame, frameSize);
+  himem.pushBaseline("before_baseline.raw", frame, frameSize);
+
+  HIMEMLIB::HimemTestResult result;
+  bool match = himem.memoryTest(result, bankErrors, maxBanks);
+  Serial.printf("memoryTest: %s, %u banks, %u bad words in %u banks, %u ms\n", match ? "pass" : "FAIL",
+    result.banks, result.errors, result.badBanks, result.millis);
+  Serial.printf("map %u us, write %u KB/s, read %u KB/s, strided write %u KB/s, strided read %u KB/s\n",
+    result.mapMicros, result.writeKBps, result.readKBps, result.stridedWriteKBps, result.stridedReadKBps);
+  for (int bank = 0; bank < result.banks && bank < maxBanks; bank++) {
+    match = match && bankErrors[bank] == 0;
+  }
+  match = match && result.banks * ESP_HIMEM_BLKSZ > empty && result.firstBadBank == -1 &&
+          result.writeKBps > 0 && result.readKBps > 0 && result.stridedWriteKBps > 0 && result.stridedReadKBps > 0;
+
+/* the store is empty and works as before */
+  match = match && himem.getFileCount() == 0 && himem.freespace() == empty && himem.getID("before.raw") == -1 &&
+          himem.recentBaseline() == -1 && himem.setBaseline(0) < 0;
+  for (int i = 0; i < frameSize; i++) {
+    frame[i] = (uint8_t)(i * 13);
+  }
+  String fileName;
+  match = match && himem.writeFile(0, "after.raw", frame, frameSize) == 0 &&
+          himem.readFile(0, fileName, readBuf) == frameSize && memcmp(readBuf, frame, frameSize) == 0;
+  match = match && himem.pushBaseline("after_baseline.raw", frame, frameSize) == 0 && himem.setBaseline(0) == 0 &&
+          himem.readFile(0, fileName, readBuf) == frameSize && memcmp(readBuf, frame, frameSize) == 0;
+
+  if (match) {
+    Serial.println("Memory test verification successful");
+  }
+}
+
+void loop() {
+}
@@ -0,0 +1,120 @@
+#include "HIMEM.h"
+
+/* -----------------------------------------------------------
+* Motion grid example
+* diffBaseline() compares a stored grayscale frame with a baseline
+* slot where they are, in the map window, and fills a grid with the
+* sum of absolute differences of each 16 x 16 cell. The old way, two
+* readFile() calls into DRAM and a compare there, is timed for
+* comparison and used to check the grid.
+----------------------------------------------------------------*/
+
+HIMEMLIB::HIMEM himem;
+
+#define stop {delay(1000); while(1);}
+#define width 320
+#define height 240
+#define frameSize (width * height)
+#define block 16
+#define cols (width / block)
+#define rows (height / block)
+#define threshold 2000
+#define frames 20
+
+uint8_t frame[frameSize];
+uint8_t baselineBuf[frameSize];
+uint32_t grid[cols * rows];
+uint32_t expected[cols * rows];
+
+/* a textured scene with an object that moves across it */
+void fillFrame(int n) {
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      frame[y * width + x] = (uint8_t)((x * 3) ^ (y * 5));
+    }
+  }
+  if (n < 0) {
+    return;
+  }
+  int left = n * 12;
+  for (int y = 80; y < 140; y++) {
+    for (int x = left; x < left + 40 && x < width; x++) {
+      frame[y * width + x] = (uint8_t)(frame[y * width + x] + 60 + n);
+    }
+  }
+}
+
+/* the old way: both frames into DRAM */
+int diffInDram(int id, int slot) {
+  String fileName;
+  if (himem.readFile(id, fileName, frame) != frameSize) {
+    return -1;
+  }
+  himem.setBaseline(slot);                  // the baseline becomes file 0 of a new event
+  if (himem.readFile(0, fileName, baselineBuf) != frameSize) {
+    return -1;
+  }
+  memset(expected, 0, sizeof(expected));
+  for (int i = 0; i < frameSize; i++) {
+    int d = frame[i] - baselineBuf[i];
+    expected[(i / width / block) * cols + (i % width) / block] += (d < 0) ? -d : d;
+  }
+  int changed = 0;
+  for (int i = 0; i < cols * rows; i++) {
+    if (expected[i] > threshold) changed++;
+  }
+  return changed;
+}
+
+bool runEvent(uint8_t windowBanks) {
+  himem.create(windowBanks, 4, 3);
+  fillFrame(-1);
+  int slot = himem.pushBaseline("scene.gray", frame, frameSize);
+  for (int n = 0; n < frames; n++) {
+    fillFrame(n);
+    if (himem.writeFile(0, "frame_" + String(n) + ".gray", frame, frameSize) != n) {
+      ESP_LOGE("setup", "Failed to write frame %d", n);
+      return false;
+    }
+  }
+
+  unsigned long start = micros();
+  int changed[frames];
+  for (int n = 0; n < frames; n++) {
+    changed[n] = himem.diffBaseline(n, slot, width, block, threshold, grid, cols * rows);
+  }
+  unsigned long inPlace = (micros() - start) / frames;
+  himem.resetMapStats();
+  himem.diffBaseline(frames / 2, slot, width, block, threshold, grid, cols * rows);
+  HIMEMLIB::HimemMapStats stats = himem.getMapStats();
+
+/* check the last frame's grid against the DRAM compare, which clears the store */
+  bool match = true;
+  for (int n = 0; n < frames; n++) {
+    match = match && changed[n] > 0;
+  }
+  himem.diffBaseline(frames - 1, slot, width, block, threshold, grid, cols * rows);
+  start = micros();
+  int expectedChanged = diffInDram(frames - 1, slot);
+  unsigned long inDram = micros() - start;
+  match = match && expectedChanged == changed[frames - 1] && memcmp(grid, expected, sizeof(grid)) == 0;
+
+  Serial.printf("%d bank window: diffBaseline %lu us (%u maps), readFile + DRAM compare %lu us, %d of %d cells changed\n",
+    windowBanks, inPlace, stats.maps, inDram, changed[frames - 1], cols * rows);
+  himem.destroy();
+  return match;
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+  ESP_LOGI("setup", "Start");
+
+  bool match = runEvent(2) && runEvent(1);
+  if (match) {
+    Serial.println("Motion grid verification successful");
+  }
+}
+
+void loop() {
+}
@@ -0,0 +1,128 @@
+#include "HIMEM.h"
+
+/* -----------------------------------------------------------
+* Operation statistics example
+* getStats() returns counts and byte totals for writes and reads,
+* failed writes by error code, the highest page written, the bank map
+* counters and latency histograms for writeFile(), readFile() and
+* getID(). A unit can send them to telemetry as they are; here the
+* store is filled until writes fail and the stats are printed as one
+* line per histogram.
+----------------------------------------------------------------*/
+
+HIMEMLIB::HIMEM himem;
+
+#define stop {delay(1000); while(1);}
+#define frameSize 60000
+
+uint8_t frame[frameSize];
+uint8_t readBuf[frameSize];
+
+uint32_t frameBytes(int n) {
+  return 20000 + (n * 7919) % (frameSize - 20000);
+}
+
+/* upper bound in us of the bucket that holds percent of the calls */
+uint32_t percentile(const HIMEMLIB::HimemHistogram& histogram, uint8_t percent) {
+  uint32_t target = (histogram.calls * percent + 99) / 100;
+  uint32_t seen = 0;
+  for (int i = 0; i < HIMEM_STAT_BUCKETS; i++) {
+    seen += histogram.buckets[i];
+    if (seen >= target && seen > 0) {
+      return (2u << i) - 1;
+    }
+  }
+  return histogram.maxMicros;
+}
+
+void printHistogram(const char* name, const HIMEMLIB::HimemHistogram& histogram) {
+  Serial.printf("%-8s %6u calls, p50 <= %u us, p99 <= %u us, max %u us, buckets:", name, histogram.calls,
+    percentile(histogram, 50), percentile(histogram, 99), histogram.maxMicros);
+  for (int i = 0; i < HIMEM_STAT_BUCKETS; i++) {
+    Serial.printf(" %u", histogram.buckets[i]);
+  }
+  Serial.printf("\n");
+}
+
+bool bucketsAddUp(const HIMEMLIB::HimemHistogram& histogram) {
+  uint32_t total = 0;
+  for (int i = 0; i < HIMEM_STAT_BUCKETS; i++) {
+    total += histogram.buckets[i];
+  }
+  return total == histogram.calls;
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+  ESP_LOGI("setup", "Start");
+
+  himem.create();
+  memset(frame, 0xA5, frameSize);
+
+/* fill the store until writes fail */
+  uint32_t written = 0;
+  uint64_t writtenBytes = 0;
+  uint32_t failed = 0;
+  for (int n = 0; failed < 3; n++) {
+    if (himem.writeFile(0, "frame_" + String(n) + ".jpg", frame, frameBytes(n)) >= 0) {
+      written++;
+      writtenBytes += frameBytes(n);
+    } else {
+      failed++;
+    }
+  }
+  String fileName;
+  uint32_t readBytes = 0;
+  for (uint32_t id = 0; id < written; id += 2) {
+    readBytes += himem.readFile(id, fileName, readBuf);
+  }
+  himem.readFile(written + 10, fileName, readBuf);
+  for (uint32_t n = 0; n < 100; n++) {
+    himem.getID("frame_" + String(n * 3) + ".jpg");
+  }
+
+  HIMEMLIB::HimemStats stats = himem.getStats();
+  Serial.printf("writes %u (%llu bytes), reads %u (%llu bytes), %u failed reads, highest page %u\n",
+    stats.writes, (unsigned long long)stats.writeBytes, stats.reads, (unsigned long long)stats.readBytes,
+    stats.readErrors, stats.highPage);
+  for (int e = 1; e < HIMEM_ERROR_CODES; e++) {
+    if (stats.writeErrors[e] > 0) {
+      Serial.printf("failed writes: %u x %s\n", stats.writeErrors[e],
+        HIMEMLIB::errorToString(static_cast<HIMEMLIB::HimemError>(-e)));
+    }
+  }
+  Serial.printf("%u files, %u bytes free, %u%% fragmented, %u maps\n", stats.files, stats.freeBytes,
+    stats.fragmentation, stats.map.maps);
+  printHistogram("writeFile", stats.writeLatency);
+  printHistogram("readFile", stats.readLatency);
+  printHistogram("getID", stats.lookupLatency);
+
+  int full = -static_cast<int>(HIMEMLIB::HimemError::INSUFFICIENT_MEMORY);
+  bool match = stats.writes == written && stats.writeBytes == writtenBytes && stats.writeErrors[full] == failed;
+  match = match && stats.reads == (written + 1) / 2 && stats.readBytes == readBytes && stats.readErrors == 1;
+  match = match && stats.writeLatency.calls == written + failed && stats.readLatency.calls == stats.reads + 1 &&
+          stats.lookupLatency.calls == 100;
+  match = match && bucketsAddUp(stats.writeLatency) && bucketsAddUp(stats.readLatency) && bucketsAddUp(stats.lookupLatency);
+  match = match && stats.files == written && stats.highPage > 0 && stats.map.maps > 0;
+
+/* counters start again from zero */
+  himem.resetStats();
+  stats = himem.getStats();
+  match = match && stats.writes == 0 && stats.readLatency.calls == 0 && stats.map.maps == 0 && stats.files == written;
+
+/* stream and burst calls are counted like writeFile() */
+  himem.closeFile(12345);
+  HIMEMLIB::HimemBatchEntry batch[2] = {{"burst_0.jpg", frame, frameSize}, {"burst_1.jpg", frame, frameSize}};
+  himem.writeFiles(batch, 2);
+  stats = himem.getStats();
+  int invalid = -static_cast<int>(HIMEMLIB::HimemError::INVALID_ID);
+  match = match && stats.writeErrors[invalid] == 1 && stats.writeErrors[full] == 1 && stats.writeLatency.calls == 2;
+
+  if (match) {
+    Serial.println("Stats verification successful");
+  }
+}
+
+void loop() {
+}
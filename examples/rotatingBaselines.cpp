@@ -0,0 +1,89 @@
+#include "HIMEM.h"
+
+/* -----------------------------------------------------------
+* Rotating baselines example
+* A high resolution sensor stores a baseline larger than one bank
+* every few seconds. pushBaseline() keeps the most recent 8 of them,
+* and when motion is detected the baseline from before the motion
+* started is made the first file of the event with setBaseline().
+* The baseline slots are reserved, so the event frames never
+* overwrite them.
+----------------------------------------------------------------*/
+
+HIMEMLIB::HIMEM himem;
+
+#define stop {delay(1000); while(1);}
+#define baselineSize 60000                  // needs 2 banks per slot
+#define baselineSlots 8
+#define baselines 20
+#define frameSize 30000
+
+uint8_t fileBuf[baselineSize];
+
+void fillBaseline(int n) {
+  for (int j = 0; j < baselineSize; j++) {
+    fileBuf[j] = (uint8_t)(j / 7 + n);
+  }
+}
+
+bool checkFile(int id, int n) {
+  String fileName;
+  if (himem.readFile(id, fileName, fileBuf) != baselineSize || fileName != "baseline_" + String(n) + ".jpg") {
+    return false;
+  }
+  for (int j = 0; j < baselineSize; j++) {
+    if (fileBuf[j] != (uint8_t)(j / 7 + n)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+  ESP_LOGI("setup", "Start");
+
+  himem.create(2, baselineSlots, 2);
+  Serial.printf("Free space with %d baseline slots of 2 banks: %lu bytes\n", baselineSlots, himem.freespace());
+
+/* periodic baselines, the oldest is overwritten once all slots are used */
+  for (int n = 0; n < baselines; n++) {
+    fillBaseline(n);
+    int slot = himem.pushBaseline("baseline_" + String(n) + ".jpg", fileBuf, baselineSize);
+    if (slot < 0) {
+      ESP_LOGE("setup", "Failed to push baseline %d", n);
+      stop;
+    }
+  }
+
+/* motion: start the event with the baseline from 3 baselines ago and fill the store with frames */
+  bool match = true;
+  int age = 3;
+  int id = himem.setBaseline(himem.recentBaseline(age));
+  match = id == 0 && checkFile(0, baselines - 1 - age);
+  memset(fileBuf, 0x55, frameSize);
+  int frames = 0;
+  while (himem.writeFile(0, "frame_" + String(frames) + ".jpg", fileBuf, frameSize) >= 0) {
+    frames++;
+  }
+  Serial.printf("Event holds the baseline and %d frames\n", frames);
+
+/* every kept baseline survives the event */
+  for (age = 0; age < baselineSlots; age++) {
+    id = himem.setBaseline(himem.recentBaseline(age));
+    if (id != 0 || !checkFile(0, baselines - 1 - age)) {
+      ESP_LOGE("setup", "Baseline %d is not intact", baselines - 1 - age);
+      match = false;
+    }
+  }
+  if (himem.recentBaseline(baselineSlots) != -1) {
+    match = false;
+  }
+  if (match) {
+    Serial.println("Baseline verification successful");
+  }
+}
+
+void loop() {
+}
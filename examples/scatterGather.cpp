@@ -0,0 +1,108 @@
+#include "HIMEM.h"
+
+/* -----------------------------------------------------------
+* Scatter/gather example
+* A camera driver hands over a JPEG as three separate buffers: the
+* header it builds, an EXIF block and the sensor payload. writeFile()
+* with segments gathers them straight into the map window, so they no
+* longer have to be assembled in a scratch buffer first. readFile()
+* with segments scatters a stored file back into separate buffers.
+----------------------------------------------------------------*/
+
+HIMEMLIB::HIMEM himem;
+
+#define stop {delay(1000); while(1);}
+#define headerSize 20
+#define exifSize 1500
+#define maxPayload 40000
+#define frames 40
+
+uint8_t header[headerSize];
+uint8_t exif[exifSize];
+uint8_t payload[maxPayload];
+uint8_t assembly[headerSize + exifSize + maxPayload];
+
+uint8_t headerIn[headerSize];
+uint8_t exifIn[exifSize];
+uint8_t payloadIn[maxPayload];
+
+uint32_t payloadBytes(int frame) {
+  return 20000 + (frame * 3331) % (maxPayload - 20000);
+}
+
+void fillFrame(int frame) {
+  const uint8_t soi[headerSize] = {0xFF, 0xD8, 0xFF, 0xE0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00, 0x01, 0x01};
+  memcpy(header, soi, headerSize);
+  header[headerSize - 1] = (uint8_t)frame;
+  for (int i = 0; i < exifSize; i++) {
+    exif[i] = (uint8_t)(i ^ frame);
+  }
+  for (uint32_t i = 0; i < payloadBytes(frame); i++) {
+    payload[i] = (uint8_t)(i * 7 + frame);
+  }
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+  ESP_LOGI("setup", "Start");
+
+  himem.create();
+
+/* the old way: assemble the parts, then write */
+  unsigned long assembled = 0;
+  for (int n = 0; n < frames; n++) {
+    fillFrame(n);
+    unsigned long start = micros();
+    memcpy(assembly, header, headerSize);
+    memcpy(assembly + headerSize, exif, exifSize);
+    memcpy(assembly + headerSize + exifSize, payload, payloadBytes(n));
+    if (himem.writeFile(0, "frame_" + String(n) + ".jpg", assembly, headerSize + exifSize + payloadBytes(n)) != n) {
+      stop;
+    }
+    assembled += micros() - start;
+  }
+
+/* the same frames gathered from their parts */
+  himem.freeMemory();
+  unsigned long gathered = 0;
+  for (int n = 0; n < frames; n++) {
+    fillFrame(n);
+    HIMEMLIB::HimemSegment parts[3] = {{header, headerSize}, {exif, exifSize}, {payload, payloadBytes(n)}};
+    unsigned long start = micros();
+    if (himem.writeFile(0, "frame_" + String(n) + ".jpg", parts, 3) != n) {
+      ESP_LOGE("setup", "Failed to write frame %d", n);
+      stop;
+    }
+    gathered += micros() - start;
+  }
+  Serial.printf("Write per frame: assemble + writeFile %lu us, writeFile with segments %lu us\n",
+    assembled / frames, gathered / frames);
+
+/* read back contiguous and scattered into the parts */
+  bool match = true;
+  for (int n = 0; n < frames && match; n++) {
+    fillFrame(n);
+    uint32_t size = headerSize + exifSize + payloadBytes(n);
+    String fileName;
+    match = himem.readFile(n, fileName, assembly) == size && memcmp(assembly, header, headerSize) == 0 &&
+            memcmp(assembly + headerSize, exif, exifSize) == 0 &&
+            memcmp(assembly + headerSize + exifSize, payload, payloadBytes(n)) == 0;
+    HIMEMLIB::HimemSegment parts[3] = {{headerIn, headerSize}, {exifIn, exifSize}, {payloadIn, maxPayload}};
+    match = match && himem.readFile(n, fileName, parts, 3) == size && fileName == "frame_" + String(n) + ".jpg" &&
+            memcmp(headerIn, header, headerSize) == 0 && memcmp(exifIn, exif, exifSize) == 0 &&
+            memcmp(payloadIn, payload, payloadBytes(n)) == 0;
+  }
+
+/* segments too small for the file are refused */
+  String fileName;
+  HIMEMLIB::HimemSegment tooSmall[2] = {{headerIn, headerSize}, {exifIn, exifSize}};
+  match = match && himem.readFile(0, fileName, tooSmall, 2) == 0;
+
+  if (match) {
+    Serial.println("Scatter/gather verification successful");
+  }
+}
+
+void loop() {
+}
@@ -0,0 +1,89 @@
+#include "HIMEM.h"
+
+/* -----------------------------------------------------------
+* Shared pool example
+* One HIMEM allocation is split between a camera store and an audio
+* store. The camera store runs as a FIFO and wraps many times during
+* a burst of frames, but it only ever retires its own files, so the
+* audio clips are untouched.
+----------------------------------------------------------------*/
+
+HIMEMLIB::HimemPool pool;                   // declared before the stores that use it
+HIMEMLIB::HIMEM camera;
+HIMEMLIB::HIMEM audio;
+
+#define stop {delay(1000); while(1);}
+#define frameSize 30000
+#define clipSize 16000
+#define clips 20
+#define audioBanks 16
+
+uint8_t fileBuf[frameSize];
+
+bool checkClips() {
+  for (int i = 0; i < clips; i++) {
+    String fileName;
+    if (audio.readFile(i, fileName, fileBuf) != clipSize) {
+      return false;
+    }
+    for (int j = 0; j < clipSize; j++) {
+      if (fileBuf[j] != (uint8_t)(j + i * 3)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+  ESP_LOGI("setup", "Start");
+
+  if (pool.begin() < 0) {
+    stop;
+  }
+  audio.create(pool, audioBanks, 1, 0);                       // no baseline slots for audio
+  camera.create(pool, pool.freeBanks(), 2);
+  camera.setFifoMode(true);
+  Serial.printf("Pool of %d banks: camera %lu bytes free, audio %lu bytes free\n",
+    pool.totalBanks(), camera.freespace(), audio.freespace());
+
+  for (int i = 0; i < clips; i++) {
+    for (int j = 0; j < clipSize; j++) {
+      fileBuf[j] = (uint8_t)(j + i * 3);
+    }
+    if (audio.writeFile(0, "clip_" + String(i) + ".wav", fileBuf, clipSize) != i) {
+      ESP_LOGE("setup", "Failed to write clip %d", i);
+      stop;
+    }
+  }
+
+/* a long camera burst, several times the size of the camera store */
+  int frames = 3 * camera.freespace() / frameSize;
+  for (int i = 0; i < frames; i++) {
+    memset(fileBuf, (uint8_t)i, frameSize);
+    if (camera.writeFile(0, "frame_" + String(i) + ".jpg", fileBuf, frameSize) < 0) {
+      ESP_LOGE("setup", "Failed to write frame %d", i);
+      stop;
+    }
+  }
+  Serial.printf("Camera wrote %d frames and holds frames %d to %d\n",
+    frames, camera.getOldestID(), camera.getNewestID());
+  bool match = checkClips() && audio.getFileCount() == clips;
+
+/* stores can be recreated with a different size, the banks and map range are reused */
+  camera.destroy();
+  camera.create(pool, pool.freeBanks() / 2, 2);
+  match = match && camera.writeFile(0, "frame.jpg", fileBuf, frameSize) == 0 && checkClips();
+  camera.destroy();
+  audio.destroy();
+  pool.end();
+
+  if (match) {
+    Serial.println("Shared pool verification successful");
+  }
+}
+
+void loop() {
+}
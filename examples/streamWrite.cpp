@@ -0,0 +1,83 @@
+#include "HIMEM.h"
+
+/* -----------------------------------------------------------
+* Streaming write example
+* Builds 200k files from 2k pieces with openFile/appendFile/closeFile
+* and verifies them with the chunked readFile(), so no buffer for the
+* whole file is needed in either direction.
+----------------------------------------------------------------*/
+
+HIMEMLIB::HIMEM himem;
+
+#define stop {delay(1000); while(1);}
+#define fileSize 200000
+#define pieceSize 2000
+
+uint8_t piece[pieceSize];
+
+/* chunk sink for readFile(), checks the data in place in the mapped window */
+struct VerifyState {
+  uint32_t offset;
+  bool match;
+};
+
+bool verifyChunk(const uint8_t* data, uint32_t bytes, void* context) {
+  VerifyState* state = (VerifyState*)context;
+  for (uint32_t j = 0; j < bytes; j++) {
+    if (data[j] != (state->offset + j) % 256) {
+      ESP_LOGE("setup", "Data mismatch at byte %u", state->offset + j);
+      state->match = false;
+      return false;
+    }
+  }
+  state->offset += bytes;
+  return true;
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+  ESP_LOGI("setup", "Start");
+
+/* initialize HIMEM */
+  himem.create();
+
+/* write files piece by piece, e.g. as a camera driver delivers them */
+  for (int i = 0; i < 5; i++) {
+    String fileName = "stream_" + String(i) + ".bin";
+    int id = himem.openFile(fileName);
+    if (id < 0) {
+      ESP_LOGE("setup", "openFile failed: %s", HIMEMLIB::errorToString(static_cast<HIMEMLIB::HimemError>(id)));
+      stop;
+    }
+    for (uint32_t offset = 0; offset < fileSize; offset += pieceSize) {
+      for (int j = 0; j < pieceSize; j++) {
+        piece[j] = (offset + j) % 256;
+      }
+      int ret = himem.appendFile(id, piece, pieceSize);
+      if (ret < 0) {
+        ESP_LOGE("setup", "appendFile failed: %s", HIMEMLIB::errorToString(static_cast<HIMEMLIB::HimemError>(ret)));
+        stop;
+      }
+    }
+    himem.closeFile(id);
+  }
+  Serial.printf("Wrote 5 files of %d bytes in %d byte pieces, %lu bytes free\n", fileSize, pieceSize, himem.freespace());
+
+/* read back and verify chunk by chunk */
+  bool match = true;
+  for (int i = 0; i < 5; i++) {
+    VerifyState state = {0, true};
+    uint32_t bytesRead = himem.readFile(i, verifyChunk, &state);
+    if (bytesRead != fileSize || !state.match) {
+      ESP_LOGE("setup", "File %d failed verification after %u bytes", i, bytesRead);
+      match = false;
+    }
+  }
+  if (match) {
+    Serial.println("Streaming write verification successful");
+  }
+}
+
+void loop() {
+}
@@ -0,0 +1,97 @@
+#include "HIMEM.h"
+
+/* -----------------------------------------------------------
+* Thumbnail index example
+* At 15 fps a camera that keeps a small thumbnail of every frame
+* writes thousands of files long before HIMEM is full. File records
+* are 16 bytes with the name kept apart, so frames can be stored
+* without a name and found by ID, while the frames worth finding by
+* name get one. The record index grows as files are written.
+----------------------------------------------------------------*/
+
+HIMEMLIB::HIMEM himem;
+
+#define stop {delay(1000); while(1);}
+#define thumbSize 1200
+#define thumbs 4000
+#define fifoThumbs 40000
+
+uint8_t thumb[thumbSize];
+uint8_t readBuf[thumbSize];
+
+uint32_t thumbBytes(int n) {
+  return 400 + (n * 97) % (thumbSize - 400);
+}
+
+void fillThumb(int n) {
+  for (uint32_t i = 0; i < thumbBytes(n); i++) {
+    thumb[i] = (uint8_t)(i + n * 5);
+  }
+}
+
+/* every 100th frame had motion and is named, the rest are kept by ID only */
+String thumbName(int n) {
+  return (n % 100 == 0) ? "motion_" + String(n) + ".jpg" : String("");
+}
+
+bool checkThumb(int id, int n) {
+  String fileName;
+  fillThumb(n);
+  return himem.readFile(id, fileName, readBuf) == thumbBytes(n) && fileName == thumbName(n) &&
+         memcmp(readBuf, thumb, thumbBytes(n)) == 0;
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+  ESP_LOGI("setup", "Start");
+
+  himem.create();
+  unsigned long empty = himem.freespace();
+
+/* far more files than one bank of the old 56 byte records held */
+  unsigned long start = micros();
+  unsigned long dataBytes = 0;
+  for (int n = 0; n < thumbs; n++) {
+    fillThumb(n);
+    dataBytes += thumbBytes(n);
+    if (himem.writeFile(0, thumbName(n), thumb, thumbBytes(n)) != n) {
+      ESP_LOGE("setup", "Failed to write thumbnail %d", n);
+      stop;
+    }
+  }
+  unsigned long writeTime = (micros() - start) / thumbs;
+  Serial.printf("%d thumbnails, %lu us per write, %lu bytes of HIMEM used for %lu bytes of thumbnails\n",
+    himem.getFileCount(), writeTime, empty - himem.freespace(), dataBytes);
+
+  bool match = himem.getFileCount() == thumbs;
+  for (int n = 0; n < thumbs && match; n += 37) {
+    match = checkThumb(n, n);
+  }
+  match = match && himem.getID("motion_3200.jpg") == 3200 && himem.getID("") == -1;
+
+/* a capture that never stops, the index only keeps the blocks of the files stored */
+  himem.setFifoMode(true);
+  for (int n = 0; n < fifoThumbs; n++) {
+    fillThumb(n);
+    if (himem.writeFile(0, thumbName(n), thumb, thumbBytes(n)) != n) {
+      ESP_LOGE("setup", "Failed to write FIFO thumbnail %d", n);
+      stop;
+    }
+  }
+  int oldest = himem.getOldestID();
+  Serial.printf("FIFO: %d thumbnails written, %d to %d stored\n", fifoThumbs, oldest, himem.getNewestID());
+  match = match && himem.getNewestID() == fifoThumbs - 1 && himem.getFileCount() > 584;
+  for (int id = oldest; id < fifoThumbs && match; id += 53) {
+    match = checkThumb(id, id);
+  }
+  match = match && himem.getID("motion_39900.jpg") == 39900;
+  himem.printMemoryStatus();
+
+  if (match) {
+    Serial.println("Thumbnail index verification successful");
+  }
+}
+
+void loop() {
+}
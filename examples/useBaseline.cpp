@@ -32,7 +32,7 @@ void setup() {
   }
 
   /* set file number 2 as the baseline */  
-  int ret = himem.setBaseline(2, fileBuf, fileBufSize);                //need to provide buffer and size to setBaseline
+  int ret = himem.setBaseline(2);                                       //copied inside HIMEM, no buffer needed
   if (ret < 0) {
     ESP_LOGE("setup", "Failed to set baseline to file ID 2, return value %d", ret);
     stop;
@@ -46,8 +46,15 @@ void setup() {
     int ret = himem.writeFile(i, fileName, fileBuf, fileBufSize);
   }
 
-/* read back files starting with the baseline */
+/* a slot that was never written is refused and the stored files are kept */
   bool match = true;
+  int files = himem.getFileCount();
+  if (himem.setBaseline(3) >= 0 || himem.getFileCount() != files) {
+    ESP_LOGE("setup", "Unwritten baseline slot 3 was set or cleared the files");
+    match = false;
+  }
+
+/* read back files starting with the baseline */
   for (int i = 0; i < 3; i++) {
     String fileName = "";
     int bytesRead = himem.getFilesize(i);
@@ -0,0 +1,100 @@
+#include "HIMEM.h"
+
+/* -----------------------------------------------------------
+* Zero copy view example
+* Frames are inspected in place in the mapped bank with viewFile()
+* instead of being copied out with readFile(). A frame that does not
+* fit in the map window is walked span by span.
+----------------------------------------------------------------*/
+
+HIMEMLIB::HIMEM himem;
+
+#define stop {delay(1000); while(1);}
+#define frameSize 20000
+#define frames 50
+#define clipSize 100000
+
+uint8_t frameBuf[frameSize];
+uint8_t clipBuf[clipSize];
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+  ESP_LOGI("setup", "Start");
+
+/* the default 2 bank window holds every frame under 32k, even one crossing a bank boundary */
+  himem.create();
+
+  for (int i = 0; i < frames; i++) {
+    for (int j = 0; j < frameSize; j++) {
+      frameBuf[j] = (uint8_t)(j + i);
+    }
+    String fileName = "frame_" + String(i) + ".jpg";
+    himem.writeFile(i, fileName, frameBuf, frameSize);
+  }
+
+/* inspect every frame without copying it */
+  bool match = true;
+  himem.resetMapStats();
+  for (int i = 0; i < frames; i++) {
+    HIMEMLIB::HimemView view = himem.viewFile(i);
+    if (!view.valid() || view.size() != frameSize || view.spans() != 1) {
+      ESP_LOGE("setup", "Could not view frame %d", i);
+      match = false;
+      continue;
+    }
+    const uint8_t* data = view.data();
+    for (uint32_t j = 0; j < view.size(); j++) {
+      if (data[j] != (uint8_t)(j + i)) {
+        ESP_LOGE("setup", "Data mismatch in frame %d at byte %u", i, j);
+        match = false;
+        break;
+      }
+    }
+  }                                                 // view released here, window may move again
+  HIMEMLIB::HimemMapStats stats = himem.getMapStats();
+  Serial.printf("Viewed %d frames with %u bank switches\n", frames, stats.maps);
+
+/* a file larger than the window is walked a span at a time */
+  for (int j = 0; j < clipSize; j++) {
+    clipBuf[j] = (uint8_t)(j * 7);
+  }
+  int clip = himem.writeFile(0, "clip.raw", clipBuf, clipSize);
+  {
+    HIMEMLIB::HimemView view = himem.viewFile(clip);
+    uint32_t pos = 0;
+    for (uint16_t i = 0; i < view.spans(); i++) {
+      HIMEMLIB::HimemSpan span = view.span(i);
+      if (span.data == nullptr || pos + span.bytes > clipSize || memcmp(span.data, clipBuf + pos, span.bytes) != 0) {
+        break;
+      }
+      pos += span.bytes;
+    }
+    Serial.printf("Viewed a %u byte clip in %u spans\n", view.size(), view.spans());
+    if (!view.valid() || view.spans() < 2 || view.data() != nullptr || pos != clipSize) {
+      ESP_LOGE("setup", "Span walk of the clip failed");
+      match = false;
+    }
+  }
+
+/* while a view is held, banks outside the window cannot be mapped */
+  {
+    HIMEMLIB::HimemView view = himem.viewFile(0);
+    String fileName;
+    if (himem.readFile(frames - 1, fileName, frameBuf) != 0) {
+      ESP_LOGE("setup", "Read outside a held view should fail");
+      match = false;
+    }
+  }
+  String fileName;
+  if (himem.readFile(frames - 1, fileName, frameBuf) != frameSize) {
+    ESP_LOGE("setup", "Read after the view was released failed");
+    match = false;
+  }
+  if (match) {
+    Serial.println("Zero copy view verification successful");
+  }
+}
+
+void loop() {
+}
@@ -0,0 +1,120 @@
+#ifndef HOST_ARDUINO_h
+#define HOST_ARDUINO_h
+
+/* -----------------------------------------------------------
+* Minimal host stand-in for the Arduino-ESP32 core
+* Provides just enough of String, Print/Serial and the timing
+* functions for the HIMEM library and its example sketches.
+----------------------------------------------------------------*/
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+class String {
+public:
+    String() {}
+    String(const char* s) : str(s ? s : "") {}
+    String(const std::string& s) : str(s) {}
+    String(char c) : str(1, c) {}
+    String(int value) : str(std::to_string(value)) {}
+    String(unsigned int value) : str(std::to_string(value)) {}
+    String(long value) : str(std::to_string(value)) {}
+    String(unsigned long value) : str(std::to_string(value)) {}
+
+    unsigned int length() const { return str.length(); }
+    const char* c_str() const { return str.c_str(); }
+    char charAt(unsigned int index) const { return index < str.length() ? str[index] : '\0'; }
+    char operator[](unsigned int index) const { return charAt(index); }
+    void toCharArray(char* buf, unsigned int bufsize, unsigned int index = 0) const {
+        if (buf == nullptr || bufsize == 0) return;
+        unsigned int n = index < str.length() ? str.length() - index : 0;
+        if (n > bufsize - 1) n = bufsize - 1;
+        memcpy(buf, str.data() + index, n);
+        buf[n] = '\0';
+    }
+    bool equals(const String& s) const { return str == s.str; }
+    bool operator==(const String& s) const { return str == s.str; }
+    bool operator==(const char* s) const { return str == (s ? s : ""); }
+    bool operator!=(const String& s) const { return str != s.str; }
+    String& operator+=(const String& s) { str += s.str; return *this; }
+    String& operator+=(const char* s) { if (s) str += s; return *this; }
+    String& operator+=(char c) { str += c; return *this; }
+    friend String operator+(const String& a, const String& b) { return String(a.str + b.str); }
+    friend String operator+(const String& a, const char* b) { return String(a.str + (b ? b : "")); }
+    friend String operator+(const char* a, const String& b) { return String((a ? a : "") + b.str); }
+
+private:
+    std::string str;
+};
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+        size_t n = 0;
+        while (size--) {
+            if (write(*buffer++) == 0) break;
+            n++;
+        }
+        return n;
+    }
+    size_t print(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+    size_t print(const String& s) { return write((const uint8_t*)s.c_str(), s.length()); }
+    size_t print(int value) { return print(String(value)); }
+    size_t println(void) { return print("\r\n"); }
+    size_t println(const char* s) { return print(s) + println(); }
+    size_t println(const String& s) { return print(s) + println(); }
+    size_t println(int value) { return print(value) + println(); }
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+class HostSerial : public Stream {
+public:
+    void begin(unsigned long baud) { (void)baud; }
+    size_t write(uint8_t c) override { return fwrite(&c, 1, 1, stdout); }
+    size_t write(const uint8_t* buffer, size_t size) override { return fwrite(buffer, 1, size, stdout); }
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    operator bool() const { return true; }
+};
+extern HostSerial Serial;
+
+class HostESP {
+public:
+    uint32_t getFreePsram(void) { return 4 * 1024 * 1024; }
+    uint32_t getFreeHeap(void) { return 320 * 1024; }
+};
+extern HostESP ESP;
+
+bool psramInit(void);
+
+// Arduino sketch entry points, called by the host sketch runner
+void setup(void);
+void loop(void);
+
+#endif
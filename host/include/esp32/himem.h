@@ -0,0 +1,44 @@
+#ifndef HOST_ESP32_HIMEM_h
+#define HOST_ESP32_HIMEM_h
+
+/* -----------------------------------------------------------
+* Host emulation of the ESP-IDF esp32/himem.h bank switching API
+*
+* Physical HIMEM is an ordinary heap block and the map ranges are
+* carved out of a separate "reserved" window, just like the 32 KiB
+* banks taken from the directly addressable 4 MiB on the ESP32.
+* esp_himem_map() copies the bank into the window and esp_himem_unmap()
+* writes it back, so code that touches a bank after unmapping it, maps
+* the same physical bank twice or overruns a range fails the same way
+* it would on the device.
+----------------------------------------------------------------*/
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define ESP_HIMEM_BLKSZ (0x8000)
+#define ESP_HIMEM_MAPFLAG_RO 1
+
+typedef struct esp_himem_ramdata_t* esp_himem_handle_t;
+typedef struct esp_himem_rangedata_t* esp_himem_rangehandle_t;
+
+esp_err_t esp_himem_alloc(size_t size, esp_himem_handle_t* handle_out);
+esp_err_t esp_himem_alloc_map_range(size_t size, esp_himem_rangehandle_t* handle_out);
+esp_err_t esp_himem_map(esp_himem_handle_t handle, esp_himem_rangehandle_t range, size_t ram_offset,
+                        size_t range_offset, size_t len, int flags, void** out_ptr);
+esp_err_t esp_himem_unmap(esp_himem_rangehandle_t range, void* ptr, size_t len);
+esp_err_t esp_himem_free(esp_himem_handle_t handle);
+esp_err_t esp_himem_free_map_range(esp_himem_rangehandle_t handle);
+size_t esp_himem_get_phys_size(void);
+size_t esp_himem_get_free_size(void);
+size_t esp_himem_reserved_area_size(void);
+
+/* -----------------------------------------------------------
+* Host only: size the emulated HIMEM before the first allocation
+* @param phys_bytes - bytes of bank switched memory (default 4 MiB)
+* @param reserve_blocks - banks reserved for map ranges (default 8)
+* @return ESP_ERR_INVALID_STATE if memory or ranges are still allocated
+----------------------------------------------------------------*/
+esp_err_t esp_himem_host_configure(size_t phys_bytes, int reserve_blocks);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef HOST_FREERTOS_h
+#define HOST_FREERTOS_h
+
+/* -----------------------------------------------------------
+* Host stand-in for the FreeRTOS kernel shipped with ESP-IDF
+* Tasks are host threads, semaphores and queues are built on a
+* mutex/condition variable pair, enough for the library's locking,
+* its drain pipeline and sketches that pin a producer and a
+* consumer task to the two cores.
+* Core affinity and priorities are accepted and ignored.
+----------------------------------------------------------------*/
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t StackType_t;
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdFAIL pdFALSE
+#define pdPASS pdTRUE
+
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+
+#endif
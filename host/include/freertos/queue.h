@@ -0,0 +1,18 @@
+#ifndef HOST_FREERTOS_QUEUE_h
+#define HOST_FREERTOS_QUEUE_h
+
+/* -----------------------------------------------------------
+* Host stand-in for FreeRTOS queues (see FreeRTOS.h)
+* Items are copied in and out by value as on the device.
+----------------------------------------------------------------*/
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_queue_t* QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticksToWait);
+BaseType_t xQueueReceive(QueueHandle_t queue, void* buffer, TickType_t ticksToWait);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+void vQueueDelete(QueueHandle_t queue);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef HOST_FREERTOS_SEMPHR_h
+#define HOST_FREERTOS_SEMPHR_h
+
+/* -----------------------------------------------------------
+* Host stand-in for FreeRTOS semaphores (see FreeRTOS.h)
+* Mutexes are binary semaphores that start out given, there is no
+* priority inheritance and no recursive take.
+----------------------------------------------------------------*/
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_semaphore_t* SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticksToWait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t sem);
+void vSemaphoreDelete(SemaphoreHandle_t sem);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef HOST_FREERTOS_TASK_h
+#define HOST_FREERTOS_TASK_h
+
+/* -----------------------------------------------------------
+* Host stand-in for FreeRTOS tasks (see FreeRTOS.h)
+* Every task runs on its own detached pthread. A task function
+* ends with vTaskDelete(NULL) as on the device.
+----------------------------------------------------------------*/
+#include "freertos/FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void* parameters);
+typedef struct host_task_t* TaskHandle_t;
+
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char* name, uint32_t stackDepth,
+                                   void* parameters, UBaseType_t priority, TaskHandle_t* handle, BaseType_t core);
+BaseType_t xTaskCreate(TaskFunction_t task, const char* name, uint32_t stackDepth,
+                       void* parameters, UBaseType_t priority, TaskHandle_t* handle);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+BaseType_t xPortGetCoreID(void);
+
+#endif
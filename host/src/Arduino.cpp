@@ -0,0 +1,107 @@
+#include <Arduino.h>
+#include <esp_log.h>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+
+/* -----------------------------------------------------------
+* Host implementations of the Arduino core and ESP-IDF helpers
+----------------------------------------------------------------*/
+
+HostSerial Serial;
+HostESP ESP;
+
+static const std::chrono::steady_clock::time_point s_boot = std::chrono::steady_clock::now();
+
+unsigned long millis(void) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - s_boot).count();
+}
+
+unsigned long micros(void) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - s_boot).count();
+}
+
+void delay(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+bool psramInit(void) {
+    return true;
+}
+
+size_t Print::printf(const char* format, ...) {
+    char stackBuf[128];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(stackBuf, sizeof(stackBuf), format, args);
+    va_end(args);
+    if (len < 0) {
+        return 0;
+    }
+    if ((size_t)len < sizeof(stackBuf)) {
+        return write((const uint8_t*)stackBuf, len);
+    }
+    std::string big(len + 1, '\0');
+    va_start(args, format);
+    vsnprintf(&big[0], big.size(), format, args);
+    va_end(args);
+    return write((const uint8_t*)big.data(), len);
+}
+
+/* -----------------------------------------------------------
+* esp_log / esp_err
+----------------------------------------------------------------*/
+// Function local state so sketches may log from global constructors
+struct log_state_t {
+    std::mutex lock;
+    std::map<std::string, esp_log_level_t> levels;
+    esp_log_level_t fallback = HIMEM_HOST_LOG_LEVEL;
+};
+
+static log_state_t& log_state(void) {
+    static log_state_t state;
+    return state;
+}
+
+void esp_log_level_set(const char* tag, esp_log_level_t level) {
+    log_state_t& s = log_state();
+    std::lock_guard<std::mutex> lock(s.lock);
+    if (strcmp(tag, "*") == 0) {
+        s.fallback = level;
+        s.levels.clear();
+        return;
+    }
+    s.levels[tag] = level;
+}
+
+void esp_log_write(esp_log_level_t level, const char* tag, const char* format, ...) {
+    log_state_t& s = log_state();
+    std::lock_guard<std::mutex> lock(s.lock);
+    auto it = s.levels.find(tag);
+    esp_log_level_t limit = (it != s.levels.end()) ? it->second : s.fallback;
+    if (level > limit) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
+
+const char* esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK: return "ESP_OK";
+        case ESP_FAIL: return "ESP_FAIL";
+        case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+        default: return "UNKNOWN ERROR";
+    }
+}
@@ -0,0 +1,298 @@
+#include "esp32/himem.h"
+#include <esp_log.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mutex>
+#include <vector>
+
+/* -----------------------------------------------------------
+* Host emulation of the ESP32 HIMEM bank switching driver
+*
+* Mirrors the bookkeeping of esp-idf components/esp32/esp_himem.c:
+* physical RAM and the reserved virtual window are both tracked as
+* 32 KiB blocks, every physical block can be mapped at most once and
+* every window block can hold at most one mapping. Mapping copies the
+* physical banks into the window, unmapping copies them back.
+----------------------------------------------------------------*/
+
+#define HOST_HIMEM_DEFAULT_PHYS (4 * 1024 * 1024)
+#define HOST_HIMEM_DEFAULT_RESERVE 8
+
+struct ramblock_t {
+    bool is_alloced;
+    bool is_mapped;
+};
+
+struct rangeblock_t {
+    bool is_alloced;
+    bool is_mapped;
+    int ram_block;
+};
+
+struct esp_himem_ramdata_t {
+    int block_ct;
+    std::vector<int> block;
+};
+
+struct esp_himem_rangedata_t {
+    int block_ct;
+    int block_start;
+};
+
+// Driver state is leaked on purpose: global HIMEM objects in sketches free
+// their handles from destructors that run after this file's statics are gone
+struct himem_host_t {
+    std::mutex lock;
+    size_t phys_bytes = HOST_HIMEM_DEFAULT_PHYS;
+    int reserve_blocks = HOST_HIMEM_DEFAULT_RESERVE;
+    uint8_t* phys = nullptr;
+    uint8_t* window = nullptr;
+    std::vector<ramblock_t> ram_descriptor;
+    std::vector<rangeblock_t> range_descriptor;
+    int alloced_handles = 0;
+};
+
+static himem_host_t& s = *new himem_host_t;
+
+static bool himem_host_init(void) {
+    if (s.phys != nullptr) {
+        return true;
+    }
+    int ram_blocks = s.phys_bytes / ESP_HIMEM_BLKSZ;
+    s.phys = (uint8_t*)calloc(ram_blocks, ESP_HIMEM_BLKSZ);
+    s.window = (uint8_t*)aligned_alloc(ESP_HIMEM_BLKSZ, (size_t)s.reserve_blocks * ESP_HIMEM_BLKSZ);
+    if (s.phys == nullptr || s.window == nullptr) {
+        free(s.phys);
+        free(s.window);
+        s.phys = nullptr;
+        s.window = nullptr;
+        return false;
+    }
+    s.ram_descriptor.assign(ram_blocks, ramblock_t{false, false});
+    s.range_descriptor.assign(s.reserve_blocks, rangeblock_t{false, false, -1});
+    return true;
+}
+
+esp_err_t esp_himem_host_configure(size_t phys_bytes, int reserve_blocks) {
+    std::lock_guard<std::mutex> lock(s.lock);
+    if (s.alloced_handles != 0) {
+        ESP_LOGE("himem_host", "Cannot reconfigure while memory or ranges are allocated");
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (phys_bytes % ESP_HIMEM_BLKSZ != 0 || reserve_blocks <= 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    free(s.phys);
+    free(s.window);
+    s.phys = nullptr;
+    s.window = nullptr;
+    s.phys_bytes = phys_bytes;
+    s.reserve_blocks = reserve_blocks;
+    return ESP_OK;
+}
+
+size_t esp_himem_get_phys_size(void) {
+    return s.phys_bytes;
+}
+
+size_t esp_himem_get_free_size(void) {
+    std::lock_guard<std::mutex> lock(s.lock);
+    if (!himem_host_init()) {
+        return 0;
+    }
+    size_t free_blocks = 0;
+    for (const ramblock_t& b : s.ram_descriptor) {
+        if (!b.is_alloced) free_blocks++;
+    }
+    return free_blocks * ESP_HIMEM_BLKSZ;
+}
+
+size_t esp_himem_reserved_area_size(void) {
+    return (size_t)s.reserve_blocks * ESP_HIMEM_BLKSZ;
+}
+
+esp_err_t esp_himem_alloc(size_t size, esp_himem_handle_t* handle_out) {
+    if (handle_out == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (size % ESP_HIMEM_BLKSZ != 0 || size == 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    std::lock_guard<std::mutex> lock(s.lock);
+    if (!himem_host_init()) {
+        return ESP_ERR_NO_MEM;
+    }
+    int blocks = size / ESP_HIMEM_BLKSZ;
+    esp_himem_ramdata_t* r = new esp_himem_ramdata_t;
+    r->block_ct = blocks;
+    for (int i = 0; i < (int)s.ram_descriptor.size() && (int)r->block.size() < blocks; i++) {
+        if (!s.ram_descriptor[i].is_alloced) {
+            r->block.push_back(i);
+        }
+    }
+    if ((int)r->block.size() < blocks) {
+        delete r;
+        return ESP_ERR_NO_MEM;
+    }
+    for (int b : r->block) {
+        s.ram_descriptor[b].is_alloced = true;
+        s.ram_descriptor[b].is_mapped = false;
+    }
+    s.alloced_handles++;
+    *handle_out = r;
+    return ESP_OK;
+}
+
+esp_err_t esp_himem_free(esp_himem_handle_t handle) {
+    if (handle == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::lock_guard<std::mutex> lock(s.lock);
+    for (int b : handle->block) {
+        if (s.ram_descriptor[b].is_mapped) {
+            ESP_LOGE("himem_host", "Trying to free HIMEM block %d that is still mapped", b);
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    for (int b : handle->block) {
+        s.ram_descriptor[b].is_alloced = false;
+    }
+    delete handle;
+    s.alloced_handles--;
+    return ESP_OK;
+}
+
+esp_err_t esp_himem_alloc_map_range(size_t size, esp_himem_rangehandle_t* handle_out) {
+    if (handle_out == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (size % ESP_HIMEM_BLKSZ != 0 || size == 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    std::lock_guard<std::mutex> lock(s.lock);
+    if (!himem_host_init()) {
+        return ESP_ERR_NO_MEM;
+    }
+    int blocks = size / ESP_HIMEM_BLKSZ;
+    int start = -1;
+    for (int i = 0; i + blocks <= s.reserve_blocks; i++) {
+        int j = 0;
+        while (j < blocks && !s.range_descriptor[i + j].is_alloced) j++;
+        if (j == blocks) {
+            start = i;
+            break;
+        }
+        i += j;
+    }
+    if (start < 0) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = start; i < start + blocks; i++) {
+        s.range_descriptor[i] = rangeblock_t{true, false, -1};
+    }
+    esp_himem_rangedata_t* r = new esp_himem_rangedata_t;
+    r->block_ct = blocks;
+    r->block_start = start;
+    s.alloced_handles++;
+    *handle_out = r;
+    return ESP_OK;
+}
+
+esp_err_t esp_himem_free_map_range(esp_himem_rangehandle_t handle) {
+    if (handle == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::lock_guard<std::mutex> lock(s.lock);
+    for (int i = handle->block_start; i < handle->block_start + handle->block_ct; i++) {
+        if (s.range_descriptor[i].is_mapped) {
+            ESP_LOGE("himem_host", "Trying to free range with block %d still mapped", i);
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    for (int i = handle->block_start; i < handle->block_start + handle->block_ct; i++) {
+        s.range_descriptor[i].is_alloced = false;
+    }
+    delete handle;
+    s.alloced_handles--;
+    return ESP_OK;
+}
+
+esp_err_t esp_himem_map(esp_himem_handle_t handle, esp_himem_rangehandle_t range, size_t ram_offset,
+                        size_t range_offset, size_t len, int flags, void** out_ptr) {
+    (void)flags;
+    if (handle == nullptr || range == nullptr || out_ptr == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (ram_offset % ESP_HIMEM_BLKSZ != 0 || range_offset % ESP_HIMEM_BLKSZ != 0 || len % ESP_HIMEM_BLKSZ != 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    int ram_block = ram_offset / ESP_HIMEM_BLKSZ;
+    int range_block = range_offset / ESP_HIMEM_BLKSZ;
+    int blockcount = len / ESP_HIMEM_BLKSZ;
+    if (ram_block + blockcount > handle->block_ct) {
+        ESP_LOGE("himem_host", "Args not in range of HIMEM handle");
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (range_block + blockcount > range->block_ct) {
+        ESP_LOGE("himem_host", "Args not in range of range handle");
+        return ESP_ERR_INVALID_SIZE;
+    }
+    std::lock_guard<std::mutex> lock(s.lock);
+    for (int i = 0; i < blockcount; i++) {
+        if (s.ram_descriptor[handle->block[ram_block + i]].is_mapped) {
+            ESP_LOGE("himem_host", "HIMEM block %d is already mapped", ram_block + i);
+            return ESP_ERR_INVALID_STATE;
+        }
+        if (s.range_descriptor[range->block_start + range_block + i].is_mapped) {
+            ESP_LOGE("himem_host", "Range block %d is already mapped", range_block + i);
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+    for (int i = 0; i < blockcount; i++) {
+        int phys = handle->block[ram_block + i];
+        int virt = range->block_start + range_block + i;
+        s.ram_descriptor[phys].is_mapped = true;
+        s.range_descriptor[virt].is_mapped = true;
+        s.range_descriptor[virt].ram_block = phys;
+        memcpy(s.window + (size_t)virt * ESP_HIMEM_BLKSZ, s.phys + (size_t)phys * ESP_HIMEM_BLKSZ, ESP_HIMEM_BLKSZ);
+    }
+    *out_ptr = s.window + (size_t)(range->block_start + range_block) * ESP_HIMEM_BLKSZ;
+    return ESP_OK;
+}
+
+esp_err_t esp_himem_unmap(esp_himem_rangehandle_t range, void* ptr, size_t len) {
+    if (range == nullptr || ptr == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::lock_guard<std::mutex> lock(s.lock);
+    ptrdiff_t range_offset = (uint8_t*)ptr - s.window;
+    if (range_offset < 0 || range_offset % ESP_HIMEM_BLKSZ != 0) {
+        ESP_LOGE("himem_host", "Range offset not block-aligned");
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (len % ESP_HIMEM_BLKSZ != 0) {
+        ESP_LOGE("himem_host", "Map length not a multiple of block size");
+        return ESP_ERR_INVALID_ARG;
+    }
+    int range_block = range_offset / ESP_HIMEM_BLKSZ - range->block_start;
+    int blockcount = len / ESP_HIMEM_BLKSZ;
+    if (range_block < 0 || range_block + blockcount > range->block_ct) {
+        ESP_LOGE("himem_host", "Range out of bounds for handle");
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < blockcount; i++) {
+        if (!s.range_descriptor[range->block_start + range_block + i].is_mapped) {
+            ESP_LOGE("himem_host", "Range block %d is not mapped", range_block + i);
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+    for (int i = 0; i < blockcount; i++) {
+        int virt = range->block_start + range_block + i;
+        int phys = s.range_descriptor[virt].ram_block;
+        memcpy(s.phys + (size_t)phys * ESP_HIMEM_BLKSZ, s.window + (size_t)virt * ESP_HIMEM_BLKSZ, ESP_HIMEM_BLKSZ);
+        s.ram_descriptor[phys].is_mapped = false;
+        s.range_descriptor[virt].is_mapped = false;
+        s.range_descriptor[virt].ram_block = -1;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,211 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <Arduino.h>
+#include <esp_log.h>
+#include <pthread.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+/* -----------------------------------------------------------
+* Host emulation of the FreeRTOS semaphore, queue and task calls
+----------------------------------------------------------------*/
+
+struct host_semaphore_t {
+    std::mutex lock;
+    std::condition_variable ready;
+    UBaseType_t count;
+    UBaseType_t maxCount;
+};
+
+static SemaphoreHandle_t host_semaphore_create(UBaseType_t maxCount, UBaseType_t initialCount) {
+    if (initialCount > maxCount) {
+        return nullptr;
+    }
+    SemaphoreHandle_t sem = new host_semaphore_t;
+    sem->count = initialCount;
+    sem->maxCount = maxCount;
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    return host_semaphore_create(1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return host_semaphore_create(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount) {
+    return host_semaphore_create(maxCount, initialCount);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticksToWait) {
+    if (sem == nullptr) {
+        return pdFALSE;
+    }
+    std::unique_lock<std::mutex> lock(sem->lock);
+    if (ticksToWait == portMAX_DELAY) {
+        sem->ready.wait(lock, [sem] { return sem->count > 0; });
+    } else if (!sem->ready.wait_for(lock, std::chrono::milliseconds((uint64_t)ticksToWait * portTICK_PERIOD_MS),
+                                    [sem] { return sem->count > 0; })) {
+        return pdFALSE;
+    }
+    sem->count--;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    if (sem == nullptr) {
+        return pdFALSE;
+    }
+    std::lock_guard<std::mutex> lock(sem->lock);
+    if (sem->count >= sem->maxCount) {
+        return pdFALSE;
+    }
+    sem->count++;
+    sem->ready.notify_one();
+    return pdTRUE;
+}
+
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t sem) {
+    std::lock_guard<std::mutex> lock(sem->lock);
+    return sem->count;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem) {
+    delete sem;
+}
+
+/* -----------------------------------------------------------
+* Queues, a ring of fixed size items
+----------------------------------------------------------------*/
+struct host_queue_t {
+    std::mutex lock;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::vector<uint8_t> items;
+    UBaseType_t length;
+    UBaseType_t itemSize;
+    UBaseType_t head = 0;
+    UBaseType_t count = 0;
+};
+
+template <typename Pred>
+static bool host_wait(std::condition_variable& cv, std::unique_lock<std::mutex>& lock, TickType_t ticks, Pred pred) {
+    if (ticks == portMAX_DELAY) {
+        cv.wait(lock, pred);
+        return true;
+    }
+    return cv.wait_for(lock, std::chrono::milliseconds((uint64_t)ticks * portTICK_PERIOD_MS), pred);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    if (length == 0 || itemSize == 0) {
+        return nullptr;
+    }
+    QueueHandle_t queue = new host_queue_t;
+    queue->items.resize((size_t)length * itemSize);
+    queue->length = length;
+    queue->itemSize = itemSize;
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticksToWait) {
+    std::unique_lock<std::mutex> lock(queue->lock);
+    if (!host_wait(queue->notFull, lock, ticksToWait, [queue] { return queue->count < queue->length; })) {
+        return pdFALSE;
+    }
+    UBaseType_t tail = (queue->head + queue->count) % queue->length;
+    memcpy(&queue->items[(size_t)tail * queue->itemSize], item, queue->itemSize);
+    queue->count++;
+    queue->notEmpty.notify_one();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* buffer, TickType_t ticksToWait) {
+    std::unique_lock<std::mutex> lock(queue->lock);
+    if (!host_wait(queue->notEmpty, lock, ticksToWait, [queue] { return queue->count > 0; })) {
+        return pdFALSE;
+    }
+    memcpy(buffer, &queue->items[(size_t)queue->head * queue->itemSize], queue->itemSize);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    queue->notFull.notify_one();
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> lock(queue->lock);
+    return queue->count;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+/* -----------------------------------------------------------
+* Tasks, one detached pthread each
+----------------------------------------------------------------*/
+struct host_task_t {
+    TaskFunction_t function;
+    void* parameters;
+    BaseType_t core;
+};
+
+static thread_local BaseType_t s_core = 0;
+
+static void* host_task_entry(void* arg) {
+    host_task_t* task = (host_task_t*)arg;
+    s_core = (task->core == tskNO_AFFINITY) ? 0 : task->core;
+    task->function(task->parameters);
+    ESP_LOGE("freertos_host", "Task returned without calling vTaskDelete(NULL)");
+    abort();
+    return nullptr;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackDepth,
+                                   void* parameters, UBaseType_t priority, TaskHandle_t* handle, BaseType_t core) {
+    (void)name;
+    (void)stackDepth;
+    (void)priority;
+    host_task_t* task = new host_task_t{function, parameters, core};
+    pthread_t thread;
+    if (pthread_create(&thread, nullptr, host_task_entry, task) != 0) {
+        delete task;
+        return pdFAIL;
+    }
+    pthread_detach(thread);
+    if (handle != nullptr) {
+        *handle = task;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stackDepth,
+                       void* parameters, UBaseType_t priority, TaskHandle_t* handle) {
+    return xTaskCreatePinnedToCore(function, name, stackDepth, parameters, priority, handle, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task != nullptr) {
+        ESP_LOGE("freertos_host", "Only a task deleting itself is supported");
+        return;
+    }
+    pthread_exit(nullptr);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    delay(ticks * portTICK_PERIOD_MS);
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return millis() / portTICK_PERIOD_MS;
+}
+
+BaseType_t xPortGetCoreID(void) {
+    return s_core;
+}
@@ -0,0 +1,17 @@
+#include <Arduino.h>
+
+/* -----------------------------------------------------------
+* Host sketch runner: calls setup() once and loop() HOST_LOOP_COUNT
+* times, standing in for the Arduino core's app_main task
+----------------------------------------------------------------*/
+#ifndef HOST_LOOP_COUNT
+#define HOST_LOOP_COUNT 1
+#endif
+
+int main(void) {
+    setup();
+    for (int i = 0; i < HOST_LOOP_COUNT; i++) {
+        loop();
+    }
+    return 0;
+}
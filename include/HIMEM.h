@@ -2,21 +2,63 @@
 #define HIMEM_h
 
 #include <Arduino.h>
-//#include "esp_heap_caps.h"
+#include "esp_heap_caps.h"
 #include "esp32/himem.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include <esp_log.h>             // Required for ESP-IDF logging macros
+#include <atomic>
+#include "HimemLZ.h"
+#include "HimemCRC.h"
 
 #define MAX_HIMEM_FILENAME_LEN 40
-#define HIMEM_FILE_HEADER_SIZE sizeof(struct_HIMEM_FileInfo)
-#define MAX_HIMEM_FILES (ESP_HIMEM_BLKSZ / sizeof(struct_HIMEM_FileInfo) - 1)
+#define HIMEM_FILE_HEADER_SIZE sizeof(struct_HIMEM_BaselineInfo)
+#define HIMEM_RECORD_BLOCK 256                                    // file records per index block, allocated as files need them
+#define HIMEM_RECORD_BLOCKS 128                                   // index blocks, one HIMEM_RECORD_SLOTS ring
+#define HIMEM_RECORD_SLOTS (HIMEM_RECORD_BLOCK * HIMEM_RECORD_BLOCKS)
+#define MAX_HIMEM_FILES (HIMEM_RECORD_SLOTS - HIMEM_RECORD_BLOCK)  // one block is kept free so blocks are never shared
+#define HIMEM_BLOCKS_PER_BANK (ESP_HIMEM_BLKSZ / (HIMEM_RECORD_BLOCK * sizeof(struct_HIMEM_FileInfo)))
+#define HIMEM_NAME_CHUNK 1024                                     // file name bytes allocated at a time for an index block
+#define HIMEM_NAME_CHUNKS 11                                      // chunks an index block can use, room for 256 full length names
+#define HIMEM_RECORD_FLUSH_THRESHOLD 32                           // dirty records before automatic flush
+#define HIMEM_NAME_INDEX_SIZE 1024                                // initial filename hash buckets, doubled as named files are added
+#define HIMEM_BASELINE_SLOTS 4                                    // default baseline slots below the record page
+#define HIMEM_BASELINE_BANKS 1                                    // default banks per baseline slot
+#define HIMEM_WINDOW_BANKS 2                                      // default banks in the map window, a file under 32k always fits
+#define HIMEM_BOUNCE_SIZE 4096                                    // concurrent mode readFile() sink chunk
+#define HIMEM_FREE_EXTENTS 64                                     // holes left by deleteFile() before a full compaction
+#define HIMEM_COMPACT_THRESHOLD 25                                // fragmentation % at which compactStep() moves files
+#define HIMEM_FILE_DELETED 0x01                                   // struct_HIMEM_FileInfo flags
+#define HIMEM_FILE_COMPRESSED 0x02                                // stored as HIMEM_LZ_BLOCK blocks, see HimemLZ.h
+#define HIMEM_FILE_DELTA 0x04                                     // stored as runs against a baseline, see writeDelta()
+#define HIMEM_FILE_CRC 0x08                                       // written with setChecksums(true), see HimemCRC.h
+#define HIMEM_DELTA_HEADER 6                                      // baseline slot, 0, baseline stamp
+#define HIMEM_DELTA_PIECE 4096                                    // runs never cross a piece, pieces decode alone
+#define HIMEM_DELTA_LITERAL 0x8000                                // run token bit, set = new bytes follow
+#define HIMEM_DELTA_MIN_RUN 8                                     // shorter unchanged runs are stored as new bytes
+#define HIMEM_DELTA_BOUND(bytes) (HIMEM_DELTA_HEADER + (bytes) + 2 * (((bytes) + HIMEM_DELTA_PIECE - 1) / HIMEM_DELTA_PIECE))
+#define HIMEM_POOL_STORES 8                                       // stores one HimemPool can be split into
+#define HIMEM_POOL_RANGES 8                                       // map ranges a HimemPool keeps for its stores
+#define HIMEM_TEST_STRIDE 32                                      // bytes between memoryTest() strided accesses, one PSRAM cache line
+#define HIMEM_STAT_BUCKETS 20                                     // latency histogram buckets, powers of 2 microseconds
+#define HIMEM_ERROR_CODES 9                                       // HimemError values 0 to -8, see HimemStats::writeErrors
 
-// File Information Structure
+// File Information Structure, the name is kept with the record's index block
 struct struct_HIMEM_FileInfo {
-    uint16_t ID;
-    char filename[MAX_HIMEM_FILENAME_LEN + 1];
-    uint32_t fileSize;
+    uint32_t fileSize;              // bytes stored in HIMEM
+    uint32_t rawSize;               // bytes read back, differs from fileSize for compressed files
     uint16_t page;
     uint16_t offset;
+    uint16_t name;                  // name offset in the index block's name chunks + 1, 0 = no name
+    uint8_t nameLength;
+    uint8_t flags;
+};
+
+// Header at the start of a baseline slot
+struct struct_HIMEM_BaselineInfo {
+    uint16_t ID;                    // first page of the slot, marks a written slot
+    char filename[MAX_HIMEM_FILENAME_LEN + 1];
+    uint32_t fileSize;
 };
 
 struct struct_HIMEM_FileInfo;
@@ -30,12 +72,165 @@ namespace HIMEMLIB {
         MAX_HIMEM_FILES_REACHED = -3,
         INSUFFICIENT_MEMORY = -4,
         INVALID_ID = -5,
-        INITIALIZATION_FAILED = -6
+        INITIALIZATION_FAILED = -6,
+        FILE_OPEN = -7,
+        CHECKSUM_MISMATCH = -8
     };
 
     // Utility function to convert error codes to strings
     const char* errorToString(HimemError error);
 
+    // Receives file data straight from the mapped window, return false to stop
+    typedef bool (*HimemChunkCallback)(const uint8_t* data, uint32_t bytes, void* context);
+
+    // One buffer of a scatter/gather writeFile() or readFile()
+    struct HimemSegment {
+        uint8_t* buf;
+        uint32_t bytes;
+    };
+
+    // One file of a HIMEM::writeFiles() batch
+    struct HimemBatchEntry {
+        const char* fileName;
+        const uint8_t* buf;
+        uint32_t bytes;
+    };
+
+    // Bank switch counters, every esp_himem_map/esp_himem_unmap made by the library
+    struct HimemMapStats {
+        uint32_t maps;
+        uint32_t unmaps;
+        uint32_t windowHits;        // page accesses served by the resident window
+        uint32_t windowMisses;      // page accesses that needed a bank switch
+        uint32_t mapMicros;         // time spent in esp_himem_map/esp_himem_unmap
+        uint16_t windowBanks;       // banks in the map range, counts against the 4 MiB address space
+    };
+
+    // Latency of one kind of call. Bucket i counts calls that took 2^i to 2^(i+1) - 1 us,
+    // bucket 0 takes 0 and 1 us and the last bucket everything longer
+    struct HimemHistogram {
+        uint32_t calls;
+        uint32_t maxMicros;
+        uint32_t buckets[HIMEM_STAT_BUCKETS];
+    };
+
+    // Operation counters since create() or resetStats(), returned by HIMEM::getStats()
+    struct HimemStats {
+        uint32_t writes;                            // files written
+        uint64_t writeBytes;                        // their size before compression
+        uint32_t writeErrors[HIMEM_ERROR_CODES];    // failed file write calls, indexed by -HimemError
+        uint32_t reads;                             // readFile() calls that returned data
+        uint64_t readBytes;
+        uint32_t readErrors;                        // readFile() calls that returned 0
+        uint16_t highPage;                          // highest write position page reached
+        uint16_t files;                             // getFileCount() when the stats were taken
+        uint32_t freeBytes;                         // freespace() when the stats were taken
+        uint8_t fragmentation;                      // getFragmentation() when the stats were taken
+        HimemMapStats map;                          // getMapStats()
+        HimemHistogram writeLatency;                // every file write call, a writeFiles() batch is one call
+        HimemHistogram readLatency;                 // readFile(), all forms
+        HimemHistogram lookupLatency;               // getID()
+    };
+
+    // Result of HIMEM::memoryTest(), the rates leave out the time spent mapping banks
+    struct HimemTestResult {
+        uint16_t banks;             // banks tested, the whole store
+        uint16_t badBanks;          // banks with at least one bad word
+        uint32_t errors;            // 32 bit words that read back wrong
+        int32_t firstBadBank;       // -1 if every bank passed
+        uint32_t mapMicros;         // average esp_himem_map + esp_himem_unmap of the window
+        uint32_t writeKBps;         // sequential 32 bit writes
+        uint32_t readKBps;          // sequential 32 bit reads
+        uint32_t stridedWriteKBps;  // writes HIMEM_TEST_STRIDE bytes apart
+        uint32_t stridedReadKBps;   // reads HIMEM_TEST_STRIDE bytes apart
+        uint32_t millis;            // time the whole test took
+    };
+
+    class HIMEM;
+
+    // One mapped run of a HimemView, valid until the view maps another span or is released
+    struct HimemSpan {
+        const uint8_t* data;
+        uint32_t bytes;
+    };
+
+    /**
+     * Zero copy view of a stored file, returned by HIMEM::viewFile()
+     * Points straight into the mapped bank window. A file that fits in the
+     * window is a single span, a larger one (or one that wraps around the
+     * FIFO) is walked a window at a time with span(). The window is held
+     * in place until the view is released or goes out of scope.
+     */
+    class HimemView {
+    public:
+        HimemView() {}
+        HimemView(HimemView&& other);
+        HimemView& operator=(HimemView&& other);
+        HimemView(const HimemView&) = delete;
+        HimemView& operator=(const HimemView&) = delete;
+        ~HimemView();
+
+        bool valid() const { return owner != nullptr; }                    // false if the file could not be viewed
+        const uint8_t* data() const { return spanCount == 1 ? ptr : nullptr; }  // whole file, nullptr if it has several spans
+        uint32_t size() const { return bytes; }                            // file size in bytes
+        uint16_t spans() const { return spanCount; }                       // mapped runs the file is split into
+        HimemSpan span(uint16_t i);                                        // map span i, earlier span pointers become invalid
+        void release();                                                    // let the window move again
+
+    private:
+        friend class HIMEM;
+        HIMEM* owner = nullptr;
+        const uint8_t* ptr = nullptr;               // data of the mapped span
+        uint32_t bytes = 0;
+        uint16_t page = 0;                          // where the file starts
+        uint32_t offset = 0;
+        uint16_t spanCount = 0;
+        uint16_t mapped = 0;                        // span ptr points at
+        uint32_t mappedBytes = 0;
+    };
+
+    /**
+     * One HIMEM allocation split between several stores
+     * Each HIMEM store created from the pool gets its own run of banks, with
+     * its own file records, baselines and allocator, so a burst of files in
+     * one store cannot evict files from another. Map ranges are kept by the
+     * pool and handed to the next store when a store is destroyed.
+     * Declare the pool before its stores and destroy the stores first.
+     */
+    class HimemPool {
+    public:
+        HimemPool() {}
+        ~HimemPool();
+        int begin(uint16_t banks = 0);                                     // Allocate HIMEM, 0 = all free HIMEM
+        void end();                                                        // Free HIMEM and the map ranges
+        uint16_t totalBanks();                                             // Banks allocated by begin()
+        uint16_t freeBanks();                                              // Banks not used by a store
+
+    private:
+        friend class HIMEM;
+        struct Store {
+            HIMEM* owner;
+            uint16_t first;
+            uint16_t banks;
+        };
+        struct Range {
+            esp_himem_rangehandle_t handle;
+            uint16_t banks;
+            bool used;
+        };
+        esp_himem_handle_t memptr = nullptr;
+        uint16_t banks = 0;
+        Store stores[HIMEM_POOL_STORES] = {};                              // sorted by first bank
+        uint8_t storeCount = 0;
+        Range ranges[HIMEM_POOL_RANGES] = {};
+        uint8_t rangeCount = 0;
+
+        int takeBanks(HIMEM* owner, uint16_t banks);
+        void giveBanks(HIMEM* owner);
+        esp_himem_rangehandle_t takeRange(uint16_t& banks);
+        void giveRange(esp_himem_rangehandle_t handle);
+    };
+
     /**
      * High Memory (HIMEM) File System
      * Provides file storage and retrieval functionality using ESP32 HIMEM
@@ -52,43 +247,262 @@ namespace HIMEMLIB {
          */
         ~HIMEM();
         // System Management
-        void create();                                                     // Initialize HIMEM file system
+        void create(uint8_t windowBanks = HIMEM_WINDOW_BANKS, uint8_t baselineSlots = HIMEM_BASELINE_SLOTS,
+                    uint8_t baselineBanks = HIMEM_BASELINE_BANKS);         // Initialize HIMEM file system
+        void create(HimemPool& pool, uint16_t banks, uint8_t windowBanks = HIMEM_WINDOW_BANKS,
+                    uint8_t baselineSlots = HIMEM_BASELINE_SLOTS,
+                    uint8_t baselineBanks = HIMEM_BASELINE_BANKS);         // Initialize as a store of banks from pool
         void destroy();                                                    // Deinitialize HIMEM file system
         void freeMemory();                                                 // Free all HIMEM resources
         unsigned long freespace();                                         // Get available HIMEM space
+        void setFifoMode(bool enable);                                     // FIFO: overwrite oldest files when full
+        int setConcurrentMode(bool enable);                                // One writer task and one reader task
+        int releaseFile(int id);                                           // Free the oldest file (FIFO/concurrent mode)
+        int deleteFile(int id);                                            // Free any file, its space is reused
+        uint32_t compactStep();                                            // Move up to one bank of data to close holes
+        uint8_t getFragmentation();                                        // Free space in holes, percent
+        void setCompactThreshold(uint8_t percent);                         // Fragmentation compactStep() waits for
+        int flushRecords();                                                // Write cached file records to HIMEM
+        void setRecordFlushThreshold(uint16_t records);                    // Dirty records before auto flush, 0 = never
+        void setTag(uint16_t tag);                                         // Tag given to files written from now on, 0 = none
+        void setChecksums(bool enable);                                    // CRC-32 files written from now on, checked on read
 
         // File Operations
-        int writeFile(int id, String fileName, uint8_t* buf, uint32_t bytes);      // Write file, return file ID or negative error code
+        int writeFile(int id, String fileName, uint8_t* buf, uint32_t bytes,
+                      bool compress = false);                                      // Write file, return file ID or negative error code
+        int writeFile(int id, String fileName, const HimemSegment* segments,
+                      uint16_t count);                                             // Write file gathered from segments
+        int writeFiles(const HimemBatchEntry* batch, uint16_t count);              // Write a burst of files, return first file ID
         uint32_t readFile(int id, String &fileName, uint8_t* buf);                 // Return number of bytes read, 0 on error
+        uint32_t readFile(int id, String &fileName, const HimemSegment* segments,
+                          uint16_t count);                                         // Scatter file into segments, 0 on error
+        uint32_t readFile(int id, HimemChunkCallback sink, void* context);         // Stream file to sink in mapped chunks
+        uint32_t readFile(int id, Print &out);                                     // Stream file to a Print/Stream (SD File)
+        HimemView viewFile(int id);                                                // Zero copy view of a file in the map window
+        int verifyFile(int id);                                                    // Check a file against its checksum, SUCCESS or CHECKSUM_MISMATCH
+        int openFile(String fileName);                                             // Start a file written in pieces, return file ID
+        int appendFile(int id, const uint8_t* buf, uint32_t bytes);                // Append to the open file
+        int closeFile(int id);                                                     // Commit the open file, return file ID
+        int writeDelta(int baseline, String fileName, uint8_t* buf, uint32_t bytes); // Write file as its changes to a baseline slot
         int writeBaseline(int id, String fileName, uint8_t* buf, uint32_t bytes);  // Writes a baseline file to slot id
-        int setBaseline(int id, uint8_t* buf, uint32_t bytes);                     // Sets baseline to the specified ID
+        int pushBaseline(String fileName, uint8_t* buf, uint32_t bytes);           // Writes over the oldest baseline, return slot
+        int recentBaseline(uint8_t age = 0);                                       // Slot of a pushed baseline, 0 = newest
+        int setBaseline(int id);                                                   // Copies baseline id to the first file, no buffer needed
+        int setBaseline(int id, uint8_t* buf, uint32_t bytes);                     // Same as setBaseline(id), buf is not used
+        int diffBaseline(int id, int baseline, uint16_t width, uint8_t block,
+                         uint32_t threshold, uint32_t* grid, uint32_t cells);      // SAD grid of a frame vs a baseline, return blocks over threshold
                 
         // File Information
         int getID(String filename);                                        // Get file ID by name, -1 if not found   
+        int getID(const char* filename);                                   // Get file ID by name, -1 if not found
         uint32_t getFilesize(int id);                                      // Get file size by ID, 0 if not found    
+        uint32_t getStoredSize(int id);                                    // Bytes the file uses in HIMEM, less than getFilesize() if compressed
         String getFileName(int id);                                        // Get file name by ID, empty string if not found
+        int getOldestID();                                                 // Oldest stored file ID, -1 if empty
+        int getNewestID();                                                 // Newest stored file ID, -1 if empty
+        uint16_t getFileCount();                                           // Number of stored files
+        uint32_t getTimestamp(int id);                                     // millis() when the file was written, 0 if not found
+        uint16_t getTag(int id);                                           // setTag() value when the file was written, 0 if not found
+        int getIDs(uint32_t from, uint32_t to, int* ids, uint16_t maxIds,
+                   int tag = -1);                                          // IDs written from..to millis(), oldest first, return count
         
         // Memory Management
         void printMemoryStatus();                                          // Print current HIMEM usage status   
-        boolean memoryTest();                                              // Test HIMEM functionality
+        boolean memoryTest();                                              // Test every bank, erases all files and baselines
+        boolean memoryTest(HimemTestResult& result, uint16_t* bankErrors = nullptr,
+                           uint16_t maxBanks = 0);                         // Same, with rates and bad words per bank
+        HimemMapStats getMapStats();                                       // Bank map/unmap calls since last reset
+        void resetMapStats();                                              // Zero the bank map/unmap counters
+        HimemStats getStats();                                             // Counts, errors and latency histograms
+        void resetStats();                                                 // Zero getStats() and the map counters
         
     protected:
         esp_himem_handle_t memptr = nullptr;
         esp_himem_rangehandle_t rangeptr = nullptr;
+        HimemPool* pool = nullptr;                                         // pool the banks and map range came from
+        HimemPool ownPool;                                                 // used by create() without a pool
+        uint16_t pageBase = 0;                                             // first bank of this store in the pool
         unsigned long himemSize = 0;
         unsigned int lastPage = 0;
-        uint16_t fileIndex = 0;
+        uint8_t baselineSlots = HIMEM_BASELINE_SLOTS;                      // slots reserved below lastPage by create()
+        uint8_t baselineBanks = HIMEM_BASELINE_BANKS;                      // banks per slot
+        uint8_t baselineNext = 0;                                          // slot pushBaseline() writes next
+        uint8_t baselineCount = 0;                                         // slots written by pushBaseline()
+        // Size and write stamp of each baseline slot, a delta file is only read back against the stamp it was written with
+        struct BaselineState {
+            uint32_t stamp;
+            uint32_t bytes;
+        };
+        BaselineState* baselineState = nullptr;
+        uint32_t baselineWrites = 0;
+        // Stored files are IDs firstID to nextID - 1. nextID and writtenBytes are only changed by the
+        // writer, firstID and retiredBytes only by whoever retires files, so no lock is needed for them
+        std::atomic<uint32_t> firstID{0};                                  // ID of the oldest stored file
+        std::atomic<uint32_t> nextID{0};                                   // ID the next file will get
+        std::atomic<uint32_t> writtenBytes{0};                             // bytes ever written since freeMemory()
+        std::atomic<uint32_t> retiredBytes{0};                             // bytes ever retired since freeMemory()
+        bool fifoMode = false;
+        bool concurrent = false;                                           // setConcurrentMode()
+        bool checksums = false;                                            // setChecksums()
+        SemaphoreHandle_t windowLock = nullptr;                            // guards the map window in concurrent mode
+        uint8_t* bounceBuf = nullptr;                                      // readFile() sink chunks in concurrent mode
+        uint8_t* packBuf = nullptr;                                        // writer: compressed block + match finder table
+        uint8_t* unpackBuf = nullptr;                                      // reader: compressed block + decompressed block
+        int32_t openID = -1;                                               // file being written by appendFile(), -1 if none
+        uint16_t deletedFiles = 0;                                         // deleted files whose ID is still in use
         uint16_t cPage;
         uint16_t cOffset;
         uint8_t pageUsed;
+
+        // File records in internal RAM, HIMEM_RECORD_BLOCK records per block. Block b holds record
+        // slots b * HIMEM_RECORD_BLOCK on, for the file IDs from base. Blocks are allocated as files
+        // need them and freed once all their files are retired. Each block has a home in the record
+        // banks that flushRecords() writes the records back to. Write times, tags and checksums stay in
+        // RAM, in arrays of their own so getIDs() searches a dense array
+        struct RecordBlock {
+            struct_HIMEM_FileInfo records[HIMEM_RECORD_BLOCK];
+            char* names[HIMEM_NAME_CHUNKS];                                // file names, null terminated
+            uint32_t times[HIMEM_RECORD_BLOCK];                            // millis() when each file was written, in ID order
+            uint16_t tags[HIMEM_RECORD_BLOCK];                             // setTag() when each file was written
+            uint32_t crcs[HIMEM_RECORD_BLOCK];                             // CRC-32 of the file data, files with HIMEM_FILE_CRC
+            uint32_t base;                                                 // file ID of records[0]
+            uint16_t nameEnd;                                              // name bytes used
+            uint16_t lastName;                                             // name of the latest record, shared by a repeat
+            uint8_t home;                                                  // place in the record banks, HIMEM_BLOCKS_PER_BANK per bank
+        };
+        RecordBlock* recordBlocks[HIMEM_RECORD_BLOCKS] = {};
+        // Record banks: lastPage, then banks taken from the top of the data pages as blocks need homes
+        std::atomic<uint16_t> recordBanks{1};
+        uint16_t dirtyFirst = 0;
+        uint16_t dirtyCount = 0;
+        uint16_t flushThreshold = HIMEM_RECORD_FLUSH_THRESHOLD;
+        uint16_t writeTag = 0;                                             // setTag()
+
+        // Filename hash index, open addressing, holds record slot + 1 (0 = empty bucket).
+        // Files without a name are not indexed. Doubled to keep it at most half full
+        uint16_t* nameIndex = nullptr;
+        uint32_t nameIndexSize = 0;
+        uint32_t namedFiles = 0;
+
+        // Holes left by deleteFile() in fill-once mode, sorted by address (page * ESP_HIMEM_BLKSZ + offset)
+        struct FreeExtent {
+            uint32_t start;
+            uint32_t bytes;
+        };
+        FreeExtent freeExtents[HIMEM_FREE_EXTENTS];
+        uint16_t extentCount = 0;
+        uint8_t compactThreshold = HIMEM_COMPACT_THRESHOLD;
+
+        // File being slid down into the lowest hole by compactStep(), -1 if none.
+        // Its first moveDone bytes are at moveTo, the rest still at moveFrom + moveDone
+        int32_t moveSlot = -1;
+        uint32_t moveFrom = 0;
+        uint32_t moveTo = 0;
+        uint32_t moveDone = 0;
         
         // Resource tracking for leak prevention
         bool isInitialized = false;
         bool memoryAllocated = false;
         bool rangeAllocated = false;
+
+        // Resident map window, pages windowPage to windowPage + windowBanks - 1
+        uint8_t* windowPtr = nullptr;
+        unsigned int windowPage = 0;
+        uint16_t windowBanks = 0;
+        uint16_t rangeBanks = 0;
+        uint16_t viewPins = 0;                                             // HimemViews holding the window in place
       
+        HimemMapStats mapStats = {};
+        HimemStats opStats = {};                                           // getStats(), map and the current state are filled in on request
+
         struct_HIMEM_FileInfo getRecord(int id);
         void cleanupResources();
+        uint8_t* pagePtr(unsigned int page, unsigned int* banks = nullptr, unsigned int minBanks = 1);
+        esp_err_t releaseWindow();
+        void unpinWindow();
+        uint16_t viewSpans(uint16_t page, uint32_t offset, uint32_t bytes, uint16_t index,
+                           uint16_t& spanPage, uint32_t& spanOffset, uint32_t& spanBytes);
+        bool mapSpan(HimemView& view, uint16_t i);
+        void lockWindow();
+        void unlockWindow();
+        friend class HimemView;
+        struct_HIMEM_FileInfo& record(uint16_t slot);
+        const char* fileName(uint16_t slot);
+        bool storeName(uint16_t slot, const char* name, uint8_t length);
+        void stampFile(uint16_t slot);
+        uint32_t fileTime(uint16_t slot);
+        uint32_t& fileCrc(uint16_t slot);
+        bool checkCrc(int slot, uint32_t crc, const char* tag);
+        uint32_t walkChecked(int slot, HimemChunkCallback sink, void* context);
+        bool reserveRecords(uint16_t newRecords);
+        bool addRecordBlock(uint32_t base);
+        void freeRecordBlocks(bool all);
+        bool growRecordBanks();
+        unsigned int recordPage(uint8_t home);
+        bool growNameIndex();
+        void markRecordDirty(uint16_t slot);
+        void extendDirty(uint16_t slot);
+        static uint32_t nameHash(const char* name);
+        void indexInsert(uint16_t slot);
+        int indexFind(const char* name);
+        bool indexRemove(uint16_t slot);
+        void reindexName(const char* name);
+        unsigned int dataPages();
+        unsigned int baselinePage(int id);
+        unsigned int regionEnd(unsigned int page);
+        void retireOldest();
+        int makeRoom(uint32_t bytes, uint32_t fileBytes, uint16_t newRecords);
+        int reserveSpace(uint32_t space, uint16_t newRecords, uint16_t& page, uint16_t& offset, bool& append);
+        bool copyIn(uint16_t& page, uint16_t& offset, const uint8_t* buf, uint32_t bytes, uint32_t* crc = nullptr);
+        int findSlot(int id, const char* tag);
+        uint32_t walkFile(int slot, HimemChunkCallback sink, void* context);
+        uint32_t walkRange(uint16_t page, uint32_t offset, uint32_t bytes, HimemChunkCallback sink, void* context);
+        uint32_t slotsUsed();
+        uint32_t cursorAddr();
+        uint32_t wilderness();
+        bool takeExtent(uint32_t bytes, uint32_t& addr);
+        void freeExtent(uint32_t start, uint32_t bytes);
+        void removeExtent(uint16_t i);
+        void absorbWilderness();
+        int fileAt(uint32_t addr);
+        uint32_t moveStep();
+        uint32_t copyBytes(uint32_t to, uint32_t from, uint32_t bytes);
+        bool copySplit(unsigned int toPage, unsigned int toPages, unsigned int fromPage, unsigned int fromPages,
+                       uint32_t toOffset, uint32_t fromOffset, uint32_t bytes);
+        bool mapSplit(unsigned int firstPage, unsigned int firstPages, unsigned int secondPage, unsigned int secondPages,
+                      uint8_t*& first, uint8_t*& second);
+        void unmapSplit(uint8_t* first, unsigned int firstPages, uint8_t* second, unsigned int secondPages);
+        bool settleMove();
+        void compactAll();
+        bool allocScratch(uint8_t*& buf, size_t bytes, const char* tag);
+        int storeFile(String& fileName, const HimemSegment* segments, uint16_t count, uint8_t flags, int baseline);
+        int storeBatch(const HimemBatchEntry* batch, uint16_t count);
+        int startFile(String& fileName);
+        int appendData(int id, const uint8_t* buf, uint32_t bytes);
+        int finishFile(int id);
+        uint32_t fetchFile(int id, String &fileName, uint8_t* buf);
+        uint32_t fetchFile(int id, String &fileName, const HimemSegment* segments, uint16_t count);
+        uint32_t fetchFile(int id, HimemChunkCallback sink, void* context);
+        int countWrite(int result, uint32_t bytes, uint16_t files, unsigned long start);
+        uint32_t countRead(uint32_t bytes, unsigned long start);
+        static void addLatency(HimemHistogram& histogram, uint32_t elapsed);
+        bool copyInPacked(uint16_t& page, uint16_t& offset, const uint8_t* buf, uint32_t bytes, uint32_t& stored,
+                          uint32_t* crc = nullptr);
+        bool copyInDelta(uint16_t& page, uint16_t& offset, const uint8_t* buf, uint32_t bytes, int baseline, uint32_t& stored,
+                         uint32_t* crc = nullptr);
+        uint32_t walkDelta(int slot, HimemChunkCallback sink, void* context);
+        uint32_t walkStored(int slot, uint32_t skip, uint32_t bytes, HimemChunkCallback sink, void* context);
+        static bool sadChunk(const uint8_t* data, uint32_t bytes, void* context);
+        static bool diffChunk(const uint8_t* data, uint32_t bytes, void* context);
+        static bool patchChunk(const uint8_t* data, uint32_t bytes, void* context);
+        static bool unpackChunk(const uint8_t* data, uint32_t bytes, void* context);
+        static bool copyChunk(const uint8_t* data, uint32_t bytes, void* context);
+        static bool scatterChunk(const uint8_t* data, uint32_t bytes, void* context);
+        static bool printChunk(const uint8_t* data, uint32_t bytes, void* context);
+        static bool checkChunk(const uint8_t* data, uint32_t bytes, void* context);
+        static bool directSink(HimemChunkCallback sink, void* context);
+        int slotForID(int id);
+        int idForSlot(int slot);
 
     };   
 }
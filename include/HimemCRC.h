@@ -0,0 +1,22 @@
+#ifndef HimemCRC_h
+#define HimemCRC_h
+
+#include <stdint.h>
+
+namespace HIMEMLIB {
+
+    /**
+     * CRC-32 (IEEE 802.3, reflected, polynomial 0xEDB88320) used for file checksums
+     * Slicing-by-8: 8 bytes per step through eight 256 entry tables. The
+     * crc argument is the result of the previous call, 0 to start, so a
+     * file can be checked in pieces.
+     */
+
+    // CRC of bytes of data
+    uint32_t crc32(uint32_t crc, const uint8_t* data, uint32_t bytes);
+
+    // Copy bytes from src to dst and return the CRC of them, in the same pass
+    uint32_t crc32Copy(uint32_t crc, uint8_t* dst, const uint8_t* src, uint32_t bytes);
+}
+
+#endif
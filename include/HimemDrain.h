@@ -0,0 +1,133 @@
+#ifndef HimemDrain_h
+#define HimemDrain_h
+
+#include "HIMEM.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <atomic>
+#include <stdio.h>
+
+#define HIMEM_DRAIN_BUFFERS 2                                     // chunk buffers, 2 = double buffering
+#define HIMEM_DRAIN_BUFFER_SIZE 16384                             // bytes per chunk buffer (internal RAM)
+#define HIMEM_DRAIN_REQUESTS 8                                    // queued drain() calls before drain() blocks
+#define HIMEM_DRAIN_STACK 4096
+
+namespace HIMEMLIB {
+
+    /**
+     * Destination for drained files, e.g. an SD card or a directory
+     * Called from the drain sink task, one file at a time.
+     */
+    class HimemSink {
+    public:
+        virtual ~HimemSink() {}
+        virtual bool open(const char* name, uint32_t size) = 0;            // start a file
+        virtual bool write(const uint8_t* data, uint32_t bytes) = 0;       // append to the open file
+        virtual bool close(bool complete) = 0;                             // finish, complete = false drops it
+    };
+
+    /**
+     * Sink writing each file to dir/name with stdio
+     * On the ESP32 dir is a VFS mount point such as "/sdcard" (SD_MMC.begin()),
+     * on the host build any existing directory.
+     */
+    class HimemDirSink : public HimemSink {
+    public:
+        HimemDirSink(const char* dir);
+        ~HimemDirSink();
+        bool open(const char* name, uint32_t size) override;
+        bool write(const uint8_t* data, uint32_t bytes) override;
+        bool close(bool complete) override;
+
+    private:
+        String dir;
+        String path;
+        FILE* file = nullptr;
+    };
+
+    // Called from the sink task when a file has been closed, ok = false if it was not written completely
+    typedef void (*HimemDrainCallback)(int id, bool ok, void* context);
+
+    struct HimemDrainStats {
+        uint32_t files;             // files written completely
+        uint32_t failures;          // files that failed to read or write
+        uint32_t bytes;             // bytes handed to the sink
+        uint32_t readMicros;        // time the read task spent copying out of HIMEM
+        uint32_t sinkMicros;        // time the sink task spent in open/write/close
+        uint32_t bufferWaits;       // times the read task waited for the sink (backpressure)
+    };
+
+    /**
+     * Background drain pipeline
+     * A read task copies files out of HIMEM into a pool of chunk buffers
+     * while a sink task writes the previous chunks to the sink, so HIMEM
+     * reads and slow sink writes overlap. When every buffer is waiting
+     * for the sink the read task blocks, and drain() blocks once
+     * HIMEM_DRAIN_REQUESTS calls are queued.
+     */
+    class HimemDrain {
+    public:
+        HimemDrain(HIMEM& store, HimemSink& sink);
+        ~HimemDrain();
+
+        int begin(BaseType_t core = 0, UBaseType_t priority = 1,
+                  uint8_t buffers = HIMEM_DRAIN_BUFFERS, uint32_t bufferSize = HIMEM_DRAIN_BUFFER_SIZE);  // Start the tasks
+        void end();                                                        // Finish queued work and stop the tasks
+        int drain(int firstID, int lastID, bool release = false);          // Queue files firstID to lastID
+        bool waitIdle(TickType_t ticks = portMAX_DELAY);                   // Wait until all queued files are written
+        uint32_t pending();                                                // Files queued or in flight
+        void onFileDone(HimemDrainCallback callback, void* context);       // Completion callback
+        HimemDrainStats getStats();                                        // Counters since begin()
+
+    private:
+        struct Chunk {
+            uint8_t* data;
+            uint32_t bytes;
+            int id;
+            uint32_t fileSize;
+            uint8_t flags;
+            bool release;
+            char name[MAX_HIMEM_FILENAME_LEN + 1];
+        };
+        struct Request {
+            int firstID;
+            int lastID;
+            bool release;
+            bool stop;
+        };
+
+        HIMEM& store;
+        HimemSink& sink;
+        QueueHandle_t requests = nullptr;
+        QueueHandle_t freeChunks = nullptr;
+        QueueHandle_t fullChunks = nullptr;
+        SemaphoreHandle_t idle = nullptr;
+        SemaphoreHandle_t stopped = nullptr;
+        Chunk* chunks = nullptr;
+        uint8_t chunkCount = 0;
+        uint32_t chunkSize = 0;
+        bool running = false;
+        std::atomic<uint32_t> inFlight{0};
+        HimemDrainCallback doneCallback = nullptr;
+        void* doneContext = nullptr;
+
+        // Read task state, only touched by the read task
+        Chunk* current = nullptr;
+        uint32_t waitMicros = 0;
+
+        // HimemDrainStats counters, updated by both tasks
+        std::atomic<uint32_t> files{0}, failures{0}, bytes{0}, readMicros{0}, sinkMicros{0}, bufferWaits{0};
+
+        static void readTask(void* param);
+        static void sinkTask(void* param);
+        static bool fillChunk(const uint8_t* data, uint32_t bytes, void* context);
+        void readOne(int id, bool release);
+        Chunk* takeChunk();
+        void sendChunk(uint8_t flags);
+        void freeResources();
+    };
+}
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef HimemLZ_h
+#define HimemLZ_h
+
+#include <stdint.h>
+
+#define HIMEM_LZ_BLOCK 4096                                       // bytes compressed independently of each other
+#define HIMEM_LZ_HEADER 2                                         // stored block length, bit 15 set = stored raw
+#define HIMEM_LZ_RAW 0x8000
+#define HIMEM_LZ_HASH_BITS 11                                     // match finder table, 2 bytes per entry
+#define HIMEM_LZ_BOUND(bytes) ((bytes) + HIMEM_LZ_HEADER * (((bytes) + HIMEM_LZ_BLOCK - 1) / HIMEM_LZ_BLOCK))
+
+namespace HIMEMLIB {
+
+    /**
+     * LZ4 style block codec used for compressed files
+     * A block is a run of sequences: a token (literal count << 4 | match
+     * length - 4), extra literal count bytes, the literals, a 2 byte
+     * little endian match offset and extra match length bytes. The last
+     * sequence has literals only.
+     */
+
+    // Compress up to HIMEM_LZ_BLOCK bytes, table holds 1 << HIMEM_LZ_HASH_BITS entries.
+    // Return the compressed size, 0 if it would not be smaller than bytes
+    uint32_t lzCompress(const uint8_t* src, uint32_t bytes, uint8_t* dst, uint16_t* table);
+
+    // Decompress a block that must decode to exactly outBytes, false if it is corrupt
+    bool lzDecompress(const uint8_t* src, uint32_t bytes, uint8_t* dst, uint32_t outBytes);
+}
+
+#endif
@@ -1,22 +1,5 @@
 #include "HIMEM.h"
 
-// Configuration Constants
-
-
-// Global Variables (shared across all HIMEM instances)
-struct_HIMEM_FileInfo* records = nullptr;        // Pointer to file records array
-
-// HIMEM Hardware Handles
-esp_himem_handle_t memptr = nullptr;        // Handle to allocated HIMEM
-esp_himem_rangehandle_t rangeptr = nullptr; // Handle to memory mapping range
-
-// Memory Layout Tracking
-unsigned long himemSize = 0;               // Total HIMEM size available
-unsigned int lastPage = 0;                 // Last page number (reserved for records)
-uint16_t fileIndex = 0;                    // Current number of stored files
-uint16_t cPage = 0;                        // Current page for new writes
-uint16_t cOffset = 0;                      // Current offset within page
-
 namespace HIMEMLIB {
 
     /**
@@ -31,6 +14,8 @@ namespace HIMEMLIB {
             case HimemError::INSUFFICIENT_MEMORY: return "Insufficient memory";
             case HimemError::INVALID_ID: return "Invalid file ID";
             case HimemError::INITIALIZATION_FAILED: return "Initialization failed";
+            case HimemError::FILE_OPEN: return "File open for writing";
+            case HimemError::CHECKSUM_MISMATCH: return "Checksum mismatch";
             default: return "Unknown error";
         }
     }
@@ -45,7 +30,6 @@ namespace HIMEMLIB {
         rangeptr = nullptr;
         himemSize = 0;
         lastPage = 0;
-        fileIndex = 0;
         cPage = 0;
         cOffset = 0;
     }
@@ -59,44 +43,103 @@ namespace HIMEMLIB {
     }
     /* ----------------------------------------------------------- 
     * HIMEM Initialization
+    * @param windowBanks - banks in the map window
+    * @param baselineSlots - baseline slots reserved below the record page
+    * @param baselineBanks - banks per baseline slot, a slot holds up to
+    *   baselineBanks * ESP_HIMEM_BLKSZ - HIMEM_FILE_HEADER_SIZE bytes
     ----------------------------------------------------------------*/    
-    void HIMEM::create() {
+    void HIMEM::create(uint8_t windowBanks, uint8_t baselineSlots, uint8_t baselineBanks) {
         // Cleanup any existing resources first
         if (isInitialized) {
             ESP_LOGW("HIMEM", "Already initialized, cleaning up previous resources");
             cleanupResources();
         }
-        
-        if (esp_himem_get_phys_size() == 0) {
-            ESP_LOGE("create", "HIMEM not initialized make sure -D BOARD_HAS_PSRAM is set");
+        // All free HIMEM as a pool with this store as its only user
+        if (ownPool.begin() < 0) {
             return;
         }
-        himemSize = esp_himem_get_free_size() - ESP_HIMEM_BLKSZ;  //Reserve one block for file records
-        if (himemSize <= ESP_HIMEM_BLKSZ) {
-            ESP_LOGE("create", "Not enough HIMEM available, only %lu bytes", himemSize);
-            return;
-        }   
-        
-        esp_err_t ret = esp_himem_alloc(himemSize, &memptr);
-        if (ret != ESP_OK) {
-            ESP_LOGE("create", "Failed to allocate HIMEM: %s", esp_err_to_name(ret));
+        create(ownPool, ownPool.totalBanks(), windowBanks, baselineSlots, baselineBanks);
+    }
+
+    /* ----------------------------------------------------------- 
+    * HIMEM Initialization as one of several stores sharing a HimemPool
+    * @param pool - pool the banks and the map range are taken from
+    * @param banks - banks for this store, including its record page and baseline slots
+    * @param windowBanks - banks in the map window
+    * @param baselineSlots - baseline slots reserved below the record page
+    * @param baselineBanks - banks per baseline slot
+    ----------------------------------------------------------------*/    
+    void HIMEM::create(HimemPool& pool, uint16_t banks, uint8_t windowBanks, uint8_t baselineSlots, uint8_t baselineBanks) {
+        if (isInitialized) {
+            ESP_LOGW("HIMEM", "Already initialized, cleaning up previous resources");
+            cleanupResources();
+        }
+        this->pool = &pool;
+        int first = pool.takeBanks(this, banks);
+        if (first < 0) {
+            ESP_LOGE("create", "No run of %d free banks in the HIMEM pool", banks);
+            cleanupResources();
             return;
         }
+        memptr = pool.memptr;
+        pageBase = first;
+        himemSize = (unsigned long)banks * ESP_HIMEM_BLKSZ;
         memoryAllocated = true;
-        
-        ret = esp_himem_alloc_map_range(ESP_HIMEM_BLKSZ, &rangeptr);
-        if (ret != ESP_OK) {
-            ESP_LOGE("create", "Failed to allocate map range: %s", esp_err_to_name(ret));
+
+        // Ask for the requested window, the pool falls back to fewer banks if the reserved area is short
+        uint16_t mapBanks = (windowBanks == 0) ? 1 : windowBanks;
+        rangeptr = pool.takeRange(mapBanks);
+        if (rangeptr == nullptr) {
             cleanupResources();
             return;
         }
         rangeAllocated = true;
+        rangeBanks = mapBanks;
+        mapStats = {};
+        opStats = {};
         
-        lastPage = himemSize / ESP_HIMEM_BLKSZ - 1;
+        lastPage = banks - 1;
+
+        // Baseline slots are carved out below the record page, the rest holds files
+        if (baselineBanks == 0) baselineBanks = 1;
+        if ((unsigned int)baselineSlots * baselineBanks >= lastPage) {
+            ESP_LOGE("create", "%d baseline slots of %d banks leave no room for files", baselineSlots, baselineBanks);
+            cleanupResources();
+            return;
+        }
+        this->baselineSlots = baselineSlots;
+        this->baselineBanks = baselineBanks;
+        baselineNext = 0;
+        baselineCount = 0;
+
+        // File records live in internal RAM in blocks allocated as files are written,
+        // the record bank copy is written back by flushRecords()
+        recordBanks = 1;
+        nameIndex = (uint16_t*)heap_caps_calloc(HIMEM_NAME_INDEX_SIZE, sizeof(uint16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (nameIndex == nullptr) {
+            ESP_LOGE("create", "Failed to allocate filename index");
+            cleanupResources();
+            return;
+        }
+        nameIndexSize = HIMEM_NAME_INDEX_SIZE;
+        namedFiles = 0;
+        if (baselineSlots > 0) {
+            baselineState = (BaselineState*)heap_caps_calloc(baselineSlots, sizeof(BaselineState), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+            if (baselineState == nullptr) {
+                ESP_LOGE("create", "Failed to allocate baseline state");
+                cleanupResources();
+                return;
+            }
+        }
+        baselineWrites = 0;
+        dirtyFirst = 0;
+        dirtyCount = 0;
         isInitialized = true;
 
         ESP_LOGI("create", "HIMEM free space: %lu bytes", freespace());
         ESP_LOGI("create", "Maximum Number of Files/buffers: %d", MAX_HIMEM_FILES);
+        ESP_LOGI("create", "Map window: %d banks (%u bytes)", rangeBanks, rangeBanks * ESP_HIMEM_BLKSZ);
+        ESP_LOGI("create", "Baselines: %d slots of %d banks", baselineSlots, baselineBanks);
         //ESP_LOGI("create", "Last Page is %d", lastPage);
         ESP_LOGI("create", "HIMEM initialized successfully");
     }
@@ -113,44 +156,86 @@ namespace HIMEMLIB {
      * Internal cleanup function to prevent memory leaks
      */
     void HIMEM::cleanupResources() {
-        // Free map range if allocated
-        if (rangeAllocated && rangeptr != nullptr) {
-            esp_err_t ret = esp_himem_free_map_range(rangeptr);
-            if (ret != ESP_OK) {
-                ESP_LOGE("cleanup", "Failed to free map range: %s", esp_err_to_name(ret));
-            } else {
-                ESP_LOGI("cleanup", "Map range freed successfully");
+        // Unmap the resident window and hand the map range and banks back to the pool
+        if (viewPins > 0) {
+            ESP_LOGW("cleanup", "%d file view(s) still held, their pointers are no longer valid", viewPins);
+            viewPins = 0;
+        }
+        releaseWindow();
+        if (pool != nullptr) {
+            if (rangeAllocated && rangeptr != nullptr) {
+                pool->giveRange(rangeptr);
             }
-            rangeptr = nullptr;
-            rangeAllocated = false;
+            pool->giveBanks(this);
+            if (pool == &ownPool) {
+                ownPool.end();                      // free HIMEM and the map range
+            }
+            pool = nullptr;
         }
+        rangeptr = nullptr;
+        rangeAllocated = false;
+        rangeBanks = 0;
+        memptr = nullptr;
+        memoryAllocated = false;
+        pageBase = 0;
 
-        // Free HIMEM if allocated
-        if (memoryAllocated && memptr != nullptr) {
-            esp_err_t ret = esp_himem_free(memptr);
-            if (ret != ESP_OK) {
-                ESP_LOGE("cleanup", "Failed to free HIMEM: %s", esp_err_to_name(ret));
-            } else {
-                ESP_LOGI("cleanup", "HIMEM freed successfully");
-            }
-            memptr = nullptr;
-            memoryAllocated = false;
+        // Free record blocks
+        freeRecordBlocks(true);
+        recordBanks = 1;
+        if (nameIndex != nullptr) {
+            heap_caps_free(nameIndex);
+            nameIndex = nullptr;
+        }
+        nameIndexSize = 0;
+        namedFiles = 0;
+        if (baselineState != nullptr) {
+            heap_caps_free(baselineState);
+            baselineState = nullptr;
+        }
+        dirtyFirst = 0;
+        dirtyCount = 0;
+
+        // Free concurrent mode lock and bounce buffer
+        if (windowLock != nullptr) {
+            vSemaphoreDelete(windowLock);
+            windowLock = nullptr;
+        }
+        if (bounceBuf != nullptr) {
+            heap_caps_free(bounceBuf);
+            bounceBuf = nullptr;
+        }
+        concurrent = false;
+
+        // Free compression scratch blocks
+        if (packBuf != nullptr) {
+            heap_caps_free(packBuf);
+            packBuf = nullptr;
+        }
+        if (unpackBuf != nullptr) {
+            heap_caps_free(unpackBuf);
+            unpackBuf = nullptr;
         }
 
         // Reset state variables
         isInitialized = false;
         himemSize = 0;
         lastPage = 0;
-        fileIndex = 0;
+        firstID = 0;
+        nextID = 0;
+        writtenBytes = 0;
+        retiredBytes = 0;
+        openID = -1;
         cPage = 0;
         cOffset = 0;
-        records = nullptr;
+        deletedFiles = 0;
+        extentCount = 0;
+        moveSlot = -1;
         
         ESP_LOGI("cleanup", "All resources cleaned up successfully");
     }
     /* ----------------------------------------------------------- 
     * Write baseline File to HIMEM
-    * @param id - baseline slot ID to write (0 - 3) upto 4 baseline pages
+    * @param id - baseline slot ID to write, 0 to the baseline slots set by create() - 1
     * @param fileName - file name of file
     * @param buf - buffer with data to write 
     * @param bytes - number of bytes to write
@@ -177,93 +262,442 @@ namespace HIMEMLIB {
                 fileName.c_str(), MAX_HIMEM_FILENAME_LEN - 1);
             return static_cast<int>(HimemError::FILENAME_TOO_LONG);
         }
-        if (id < 0 || id > 3) {
+        if (id < 0 || id >= baselineSlots) {
             ESP_LOGE("writeFile", "Invalid baseline slot ID");
             return static_cast<int>(HimemError::INVALID_ID);
         }
-        if (bytes > ESP_HIMEM_BLKSZ - sizeof(struct_HIMEM_FileInfo)) {
-            ESP_LOGE("writeFile", "File is too large to fit in a single HIMEM slot, %d", ESP_HIMEM_BLKSZ);
+        if (bytes > baselineBanks * ESP_HIMEM_BLKSZ - sizeof(struct_HIMEM_BaselineInfo)) {
+            ESP_LOGE("writeFile", "File is too large to fit in a HIMEM baseline slot, %d", baselineBanks * ESP_HIMEM_BLKSZ);
             return static_cast<int>(HimemError::FILE_TOO_LARGE);
         }
-    /* Save File Information and write file to HIMEM page */
-        struct_HIMEM_FileInfo* info = nullptr;
-        int page = lastPage - (id + 1);
-        
-        esp_err_t ret = esp_himem_map(memptr, rangeptr, page * ESP_HIMEM_BLKSZ, 0, ESP_HIMEM_BLKSZ, 0, (void**)&info);
-        if (ret != ESP_OK) {
-            ESP_LOGE("writeBaseline", "Failed to map HIMEM page %d: %s", page, esp_err_to_name(ret));
+    /* Save File Information and write file to HIMEM pages, delta files written against the old baseline become unreadable */
+        baselineState[id].stamp = ++baselineWrites;
+        baselineState[id].bytes = bytes;
+        int page = baselinePage(id);
+        lockWindow();
+        struct_HIMEM_BaselineInfo* info = (struct_HIMEM_BaselineInfo*)pagePtr(page);
+        if (info == nullptr) {
+            unlockWindow();
+            ESP_LOGE("writeBaseline", "Failed to map HIMEM page %d", page);
             return static_cast<int>(HimemError::INITIALIZATION_FAILED);
         }
         
         info->ID = page;
-        info->fileSize = bytes;
         fileName.toCharArray(info->filename, fileName.length() + 1);
-        info->page = page;
-        info->offset = 0;
-        memcpy((uint8_t*)info + sizeof(struct_HIMEM_FileInfo), buf, bytes);
-        
-        ret = esp_himem_unmap(rangeptr, info, ESP_HIMEM_BLKSZ);
-        if (ret != ESP_OK) {
-            ESP_LOGE("writeBaseline", "Failed to unmap HIMEM: %s", esp_err_to_name(ret));
+        info->fileSize = bytes;
+        unlockWindow();
+        uint16_t dataPage = page;
+        uint16_t dataOffset = sizeof(struct_HIMEM_BaselineInfo);
+        if (!copyIn(dataPage, dataOffset, buf, bytes)) {
             return static_cast<int>(HimemError::INITIALIZATION_FAILED);
         }
         return page;
     }
 
+    /* ----------------------------------------------------------- 
+    * Write a baseline over the oldest one, keeping the most recent
+    * baselines (as many as there are slots) for motion comparisons
+    * @param fileName - file name of file
+    * @param buf - buffer with data to write 
+    * @param bytes - number of bytes to write
+    * @return baseline slot ID written, negative on error
+    ----------------------------------------------------------------*/
+    int HIMEM::pushBaseline(String fileName, uint8_t* buf, uint32_t bytes) {
+        if (baselineSlots == 0) {
+            ESP_LOGE("pushBaseline", "No baseline slots, see create()");
+            return static_cast<int>(HimemError::INVALID_ID);
+        }
+        int id = baselineNext;
+        int ret = writeBaseline(id, fileName, buf, bytes);
+        if (ret < 0) {
+            return ret;
+        }
+        baselineNext = (id + 1) % baselineSlots;
+        if (baselineCount < baselineSlots) baselineCount++;
+        return id;
+    }
+
+    /**
+     * Slot of a baseline written by pushBaseline(), age 0 is the newest, -1 if there is none that old
+     */
+    int HIMEM::recentBaseline(uint8_t age) {
+        if (age >= baselineCount) {
+            return -1;
+        }
+        return (baselineNext + baselineSlots - 1 - age) % baselineSlots;
+    }
+
+    /**
+     * End of the region page is in, the data pages or the baseline slots above them
+     */
+    unsigned int HIMEM::regionEnd(unsigned int page) {
+        return (page < dataPages()) ? dataPages() : lastPage;
+    }
+
+    /**
+     * First page of baseline slot id, slots are stacked down from the record page
+     */
+    unsigned int HIMEM::baselinePage(int id) {
+        return lastPage - (id + 1) * baselineBanks;
+    }
+
     /* ----------------------------------------------------------- 
     * Set baseline File, copies identified baseline to first file location in HIMEM
-    * @param buf - provide a buffer to temporarily hold data to write 
-    * @param bytes - number of bytes available in the buffer
+    * All stored files are cleared. The baseline is copied bank to bank
+    * inside HIMEM, through the map window or a small internal bounce
+    * buffer, so no caller buffer is needed.
+    * @param id - baseline slot ID, e.g. recentBaseline(n)
     * @return id - write file ID, negative on error
     ----------------------------------------------------------------*/
-    int HIMEM::setBaseline(int id, uint8_t* buf, uint32_t bytes) {
-    /* Read baseline File Information and write file to HIMEM page */
-        HIMEM::freeMemory();                       // Free first file slot
-        struct_HIMEM_FileInfo* info = nullptr;
-        int page = lastPage - (id + 1);
-        
-        esp_err_t ret = esp_himem_map(memptr, rangeptr, page * ESP_HIMEM_BLKSZ, 0, ESP_HIMEM_BLKSZ, 0, (void**)&info);
-        if (ret != ESP_OK) {
-            ESP_LOGE("setBaseline", "Failed to map HIMEM page %d: %s", page, esp_err_to_name(ret));
+    int HIMEM::setBaseline(int id) {
+        if (!isInitialized) {
+            ESP_LOGE("setBaseline", "HIMEM not initialized");
             return static_cast<int>(HimemError::INITIALIZATION_FAILED);
         }
-        unsigned long fileBytes = info->fileSize;
-        if (bytes < fileBytes) {
-            ESP_LOGE("setBaseline", "Provided buffer too small for baseline data");
-            esp_himem_unmap(rangeptr, info, ESP_HIMEM_BLKSZ);
-            return static_cast<int>(HimemError::INSUFFICIENT_MEMORY);
+        if (id < 0 || id >= baselineSlots) {
+            ESP_LOGE("setBaseline", "Invalid baseline slot ID");
+            return static_cast<int>(HimemError::INVALID_ID);
         }
-        String filename = String(info->filename);
-        memcpy(buf, (uint8_t*)info + sizeof(struct_HIMEM_FileInfo), fileBytes);
-        ret = esp_himem_unmap(rangeptr, info, ESP_HIMEM_BLKSZ);
-        if (ret != ESP_OK) {
-            ESP_LOGE("setBaseline", "Failed to unmap HIMEM: %s", esp_err_to_name(ret));
+    /* Read baseline File Information */
+        int page = baselinePage(id);
+        lockWindow();
+        struct_HIMEM_BaselineInfo* info = (struct_HIMEM_BaselineInfo*)pagePtr(page);
+        if (info == nullptr) {
+            unlockWindow();
+            ESP_LOGE("setBaseline", "Failed to map HIMEM page %d", page);
             return static_cast<int>(HimemError::INITIALIZATION_FAILED);
         }
-        if (page != info->ID) {
+        struct_HIMEM_BaselineInfo baseline = *info;
+        unlockWindow();
+        baseline.filename[MAX_HIMEM_FILENAME_LEN] = 0;
+        if (page != baseline.ID || baseline.fileSize == 0 ||
+            baseline.fileSize > baselineBanks * ESP_HIMEM_BLKSZ - sizeof(struct_HIMEM_BaselineInfo)) {
             ESP_LOGE("setBaseline", "Baseline ID %d page mismatch, baseline not set", id);
             return static_cast<int>(HimemError::INVALID_ID);
         }
-        int writeRet = writeFile(0, filename, buf, bytes);
-        return writeRet;
+        HIMEM::freeMemory();                       // Free first file slot, only once the baseline checks out
+        if (!reserveRecords(1)) {
+            return static_cast<int>(HimemError::MAX_HIMEM_FILES_REACHED);
+        }
+    /* Copy it to the first file location */
+        uint32_t fileBytes = baseline.fileSize;
+        uint32_t fileID = nextID;
+        int slot = fileID % HIMEM_RECORD_SLOTS;
+        if (!storeName(slot, baseline.filename, strlen(baseline.filename))) {
+            return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+        }
+        stampFile(slot);
+        record(slot).flags = 0;
+        record(slot).fileSize = fileBytes;
+        record(slot).rawSize = fileBytes;
+        record(slot).page = cPage;
+        record(slot).offset = cOffset;
+        uint32_t to = cursorAddr();
+        uint32_t from = (uint32_t)page * ESP_HIMEM_BLKSZ + sizeof(struct_HIMEM_BaselineInfo);
+        for (uint32_t copied = 0; copied < fileBytes; ) {
+            uint32_t piece = copyBytes(to + copied, from + copied, fileBytes - copied);
+            if (piece == 0) {
+                return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+            }
+            copied += piece;
+        }
+        cPage = (to + fileBytes) / ESP_HIMEM_BLKSZ;
+        cOffset = (to + fileBytes) % ESP_HIMEM_BLKSZ;
+        writtenBytes += fileBytes;
+        lockWindow();
+        indexInsert(slot);
+        unlockWindow();
+        markRecordDirty(slot);
+        nextID = fileID + 1;
+        return (int)fileID;
+    }
+
+    /**
+     * Older form of setBaseline(id), the baseline no longer passes through buf
+     */
+    int HIMEM::setBaseline(int id, uint8_t* buf, uint32_t bytes) {
+        (void)buf;
+        (void)bytes;
+        return setBaseline(id);
+    }
+
+    /**
+     * Sum of absolute differences of n bytes, 4 bytes per step in 32 bit words.
+     * Even and odd bytes are spread into 16 bit lanes with a guard bit, so a
+     * lane subtracts without borrowing from its neighbour
+     */
+    static uint32_t sadBytes(const uint8_t* a, const uint8_t* b, uint32_t n) {
+        uint32_t lanes = 0;
+        uint32_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            uint32_t x;
+            uint32_t y;
+            memcpy(&x, a + i, 4);
+            memcpy(&y, b + i, 4);
+            for (int shift = 0; shift < 16; shift += 8) {
+                uint32_t xs = (x >> shift) & 0x00FF00FF;
+                uint32_t ys = (y >> shift) & 0x00FF00FF;
+                uint32_t up = (xs | 0x01000100) - ys;               // 256 + x - y per lane
+                uint32_t down = (ys | 0x01000100) - xs;             // 256 + y - x per lane
+                uint32_t mask = ((up >> 8) & 0x00010001) * 0xFF;    // lanes where x >= y
+                lanes += (up & mask) | (down & ~mask & 0x00FF00FF);
+            }
+        }
+        uint32_t sum = (lanes & 0xFFFF) + (lanes >> 16);
+        for (; i < n; i++) {
+            sum += (a[i] > b[i]) ? a[i] - b[i] : b[i] - a[i];
+        }
+        return sum;
+    }
+
+    /**
+     * State of diffBaseline(), pos is the frame byte the next span starts at
+     */
+    struct HimemSad {
+        uint32_t* grid;
+        uint32_t pos;
+        uint16_t width;
+        uint16_t cols;
+        uint8_t block;
+        const uint8_t* baseline;                    // baseline piece for sadChunk()
+    };
+
+    /**
+     * Add the differences of a span of frame and baseline to the grid cells it covers,
+     * one row segment inside a cell at a time (at most 255 bytes, so the 16 bit lanes cannot overflow)
+     */
+    static void sadSpan(HimemSad* sad, const uint8_t* frame, const uint8_t* baseline, uint32_t bytes) {
+        while (bytes > 0) {
+            uint32_t y = sad->pos / sad->width;
+            uint32_t x = sad->pos % sad->width;
+            uint32_t n = sad->block - x % sad->block;
+            if (n > sad->width - x) n = sad->width - x;
+            if (n > bytes) n = bytes;
+            sad->grid[(y / sad->block) * sad->cols + x / sad->block] += sadBytes(frame, baseline, n);
+            frame += n;
+            baseline += n;
+            sad->pos += n;
+            bytes -= n;
+        }
+    }
+
+    bool HIMEM::sadChunk(const uint8_t* data, uint32_t bytes, void* context) {
+        HimemSad* sad = (HimemSad*)context;
+        sadSpan(sad, data, sad->baseline, bytes);
+        sad->baseline += bytes;
+        return true;
+    }
+
+    /* ----------------------------------------------------------- 
+    * Compare a stored frame with a baseline slot for motion detection
+    * The frame is split into block x block pixel cells and grid gets the
+    * sum of absolute differences of each cell, row by row. Both are read
+    * in place: with a map window of 2 or more banks (the default) frame and
+    * baseline banks are mapped side by side, with a 1 bank window the
+    * baseline goes through an 8k internal scratch block. No frame sized
+    * buffer is needed.
+    * @param id - file ID of an 8 bit grayscale frame, not compressed or delta
+    * @param baseline - baseline slot of the same size
+    * @param width - frame width in bytes
+    * @param block - cell size in pixels
+    * @param threshold - a cell with a larger sum counts as changed
+    * @param grid - output, at least ceil(width / block) * ceil(height / block) cells
+    * @param cells - number of cells in grid
+    * @return number of changed cells, negative on error
+    ----------------------------------------------------------------*/
+    int HIMEM::diffBaseline(int id, int baseline, uint16_t width, uint8_t block, uint32_t threshold, uint32_t* grid, uint32_t cells) {
+        if (!isInitialized) {
+            ESP_LOGE("diffBaseline", "HIMEM not initialized");
+            return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+        }
+        int slot = findSlot(id, "diffBaseline");
+        if (slot < 0) {
+            return static_cast<int>(HimemError::INVALID_ID);
+        }
+        if (baseline < 0 || baseline >= baselineSlots || baselineState[baseline].stamp == 0) {
+            ESP_LOGE("diffBaseline", "Baseline slot %d has not been written", baseline);
+            return static_cast<int>(HimemError::INVALID_ID);
+        }
+        if (record(slot).flags & (HIMEM_FILE_COMPRESSED | HIMEM_FILE_DELTA)) {
+            ESP_LOGE("diffBaseline", "File %d is stored compressed or as a delta", id);
+            return static_cast<int>(HimemError::INVALID_ID);
+        }
+        uint32_t bytes = record(slot).fileSize;
+        if (bytes != baselineState[baseline].bytes) {
+            ESP_LOGE("diffBaseline", "File %d is %u bytes, baseline %d is %u", id, bytes, baseline, baselineState[baseline].bytes);
+            return static_cast<int>(HimemError::INVALID_ID);
+        }
+        if (grid == nullptr || width == 0 || block == 0) {
+            ESP_LOGE("diffBaseline", "No grid, width or block size");
+            return static_cast<int>(HimemError::INVALID_ID);
+        }
+        uint16_t cols = (width + block - 1) / block;
+        uint32_t rows = ((bytes + width - 1) / width + block - 1) / block;
+        if (cells < cols * rows) {
+            ESP_LOGE("diffBaseline", "Grid needs %u cells, has %u", cols * rows, cells);
+            return static_cast<int>(HimemError::INVALID_ID);
+        }
+        if (slot == moveSlot && !settleMove()) {
+            return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+        }
+        memset(grid, 0, cols * rows * sizeof(uint32_t));
+        HimemSad sad = {grid, 0, width, cols, block, nullptr};
+        uint32_t frameAddr = (uint32_t)record(slot).page * ESP_HIMEM_BLKSZ + record(slot).offset;
+        uint32_t baseAddr = baselinePage(baseline) * ESP_HIMEM_BLKSZ + sizeof(struct_HIMEM_BaselineInfo);
+
+        if (rangeBanks >= 2 && viewPins == 0) {
+            // Frame banks in the first half of the map range, baseline banks in the second
+            unsigned int half = rangeBanks / 2;
+            while (sad.pos < bytes) {
+                unsigned int framePage = frameAddr / ESP_HIMEM_BLKSZ;
+                unsigned int basePage = baseAddr / ESP_HIMEM_BLKSZ;
+                uint32_t frameOffset = frameAddr % ESP_HIMEM_BLKSZ;
+                uint32_t baseOffset = baseAddr % ESP_HIMEM_BLKSZ;
+                unsigned int framePages = regionEnd(framePage) - framePage;
+                if (framePages > half) framePages = half;
+                unsigned int basePages = rangeBanks - framePages;
+                uint32_t span = bytes - sad.pos;
+                if (span > framePages * ESP_HIMEM_BLKSZ - frameOffset) span = framePages * ESP_HIMEM_BLKSZ - frameOffset;
+                if (span > basePages * ESP_HIMEM_BLKSZ - baseOffset) span = basePages * ESP_HIMEM_BLKSZ - baseOffset;
+                framePages = (frameOffset + span - 1) / ESP_HIMEM_BLKSZ + 1;
+                basePages = (baseOffset + span - 1) / ESP_HIMEM_BLKSZ + 1;
+                uint8_t* frame = nullptr;
+                uint8_t* base = nullptr;
+                lockWindow();
+                if (!mapSplit(framePage, framePages, basePage, basePages, frame, base)) {
+                    unlockWindow();
+                    return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+                }
+                sadSpan(&sad, frame + frameOffset, base + baseOffset, span);
+                unmapSplit(frame, framePages, base, basePages);
+                unlockWindow();
+                frameAddr += span;
+                baseAddr += span;
+                if (fifoMode && frameAddr >= dataPages() * ESP_HIMEM_BLKSZ) {
+                    frameAddr = 0;                  // frame wraps to the first data page
+                }
+            }
+        } else {
+            // One bank of window: the baseline 8k at a time through scratch, the frame in place
+            if (!allocScratch(unpackBuf, 2 * HIMEM_LZ_BLOCK, "diffBaseline")) {
+                return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+            }
+            for (uint32_t pos = 0; pos < bytes; pos += 2 * HIMEM_LZ_BLOCK) {
+                uint32_t piece = (bytes - pos < 2 * HIMEM_LZ_BLOCK) ? bytes - pos : 2 * HIMEM_LZ_BLOCK;
+                uint32_t addr = baseAddr + pos;
+                uint8_t* cursor = unpackBuf;
+                if (walkRange(addr / ESP_HIMEM_BLKSZ, addr % ESP_HIMEM_BLKSZ, piece, copyChunk, &cursor) != piece) {
+                    return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+                }
+                sad.baseline = unpackBuf;
+                if (walkStored(slot, pos, piece, sadChunk, &sad) != piece) {
+                    return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+                }
+            }
+        }
+        int changed = 0;
+        for (uint32_t i = 0; i < cols * rows; i++) {
+            if (grid[i] > threshold) changed++;
+        }
+        return changed;
     }
+
     /* ----------------------------------------------------------- 
     * Write File to HIMEM
+    * @param id - ignored, files are numbered in write order; kept for existing callers
     * @param fileName - file name output to String
     * @param buf - buffer with data to write 
     * @param bytes - number of bytes to write
+    * @param compress - store the file LZ compressed, readFile() returns the original bytes
+    * @return file Id number, negative on error
+    ----------------------------------------------------------------*/
+    int HIMEM::writeFile(int id, String fileName, uint8_t* buf, uint32_t bytes, bool compress) {
+        (void)id;
+        unsigned long start = micros();
+        HimemSegment segment = {buf, bytes};
+        int result = storeFile(fileName, &segment, 1, compress ? HIMEM_FILE_COMPRESSED : 0, -1);
+        return countWrite(result, bytes, 1, start);
+    }
+
+    /* ----------------------------------------------------------- 
+    * Write File to HIMEM gathered from several buffers, e.g. a JPEG
+    * header, an EXIF block and the sensor payload. Each segment is
+    * copied straight into the map window, no assembly buffer is needed.
+    * @param id - ignored, as for writeFile() from one buffer
+    * @param fileName - file name
+    * @param segments - buffers in file order, empty segments are skipped
+    * @param count - number of segments
+    * @return file Id number, negative on error
+    ----------------------------------------------------------------*/
+    int HIMEM::writeFile(int id, String fileName, const HimemSegment* segments, uint16_t count) {
+        (void)id;
+        unsigned long start = micros();
+        int result = static_cast<int>(HimemError::INVALID_ID);
+        uint32_t bytes = 0;
+        if (segments == nullptr || count == 0) {
+            ESP_LOGE("writeFile", "No segments");
+        } else {
+            result = storeFile(fileName, segments, count, 0, -1);
+            for (uint16_t i = 0; i < count; i++) {
+                bytes += segments[i].bytes;
+            }
+        }
+        return countWrite(result, bytes, 1, start);
+    }
+
+    /* ----------------------------------------------------------- 
+    * Write File to HIMEM as its difference to a baseline slot
+    * Only the runs of bytes that differ from the baseline are stored, so
+    * frames that change in a small region take a fraction of their size.
+    * readFile() rebuilds the frame from the baseline, which must not be
+    * overwritten while the file is needed; once it is, reading the file
+    * fails.
+    * @param baseline - baseline slot written with writeBaseline() or pushBaseline()
+    * @param fileName - file name
+    * @param buf - buffer with data to write
+    * @param bytes - number of bytes to write, may differ from the baseline size
     * @return file Id number, negative on error
     ----------------------------------------------------------------*/
-    int HIMEM::writeFile(int id, String fileName, uint8_t* buf, uint32_t bytes) {
+    int HIMEM::writeDelta(int baseline, String fileName, uint8_t* buf, uint32_t bytes) {
+        unsigned long start = micros();
+        int result;
+        if (!isInitialized) {
+            ESP_LOGE("writeDelta", "HIMEM not initialized");
+            result = static_cast<int>(HimemError::INITIALIZATION_FAILED);
+        } else if (baseline < 0 || baseline >= baselineSlots || baselineState[baseline].stamp == 0) {
+            ESP_LOGE("writeDelta", "Baseline slot %d has not been written", baseline);
+            result = static_cast<int>(HimemError::INVALID_ID);
+        } else {
+            HimemSegment segment = {buf, bytes};
+            result = storeFile(fileName, &segment, 1, HIMEM_FILE_DELTA, baseline);
+        }
+        return countWrite(result, bytes, 1, start);
+    }
+
+    /**
+     * Allocate and write a file for writeFile()/writeDelta(), flags selects how it is stored.
+     * Compressed and delta files are written from a single segment
+     */
+    int HIMEM::storeFile(String& fileName, const HimemSegment* segments, uint16_t count, uint8_t flags, int baseline) {
     /* Check for Initialization and Safety */
         if (!isInitialized) {
             ESP_LOGE("writeFile", "HIMEM not initialized");
             return static_cast<int>(HimemError::INITIALIZATION_FAILED);
         }
-        if (buf == nullptr) {
-            ESP_LOGE("writeFile", "Buffer pointer is null");
-            return static_cast<int>(HimemError::INVALID_ID);
+        uint64_t total = 0;
+        for (uint16_t i = 0; i < count; i++) {
+            if (segments[i].buf == nullptr && segments[i].bytes > 0) {
+                ESP_LOGE("writeFile", "Buffer pointer is null");
+                return static_cast<int>(HimemError::INVALID_ID);
+            }
+            total += segments[i].bytes;
+        }
+        if (total > himemSize) {
+            ESP_LOGE("writeFile", "File is larger than HIMEM");
+            return static_cast<int>(HimemError::FILE_TOO_LARGE);
         }
+        uint32_t bytes = (uint32_t)total;
+        const uint8_t* buf = segments[0].buf;
         if (bytes == 0) {
             ESP_LOGE("writeFile", "Cannot write 0 bytes");
             return static_cast<int>(HimemError::FILE_TOO_LARGE);
@@ -275,224 +709,2469 @@ namespace HIMEMLIB {
                 fileName.c_str(), MAX_HIMEM_FILENAME_LEN - 1);
             return static_cast<int>(HimemError::FILENAME_TOO_LONG);
         }
-        if (freespace() < bytes) {
-            ESP_LOGE("writeFile", "File is larger than available HIMEM");
-            return static_cast<int>(HimemError::INSUFFICIENT_MEMORY);
+        if (openID >= 0) {
+            ESP_LOGE("writeFile", "File %d is open for writing", openID);
+            return static_cast<int>(HimemError::FILE_OPEN);
+        }
+    /* A compressed or delta file is given room for its worst case, the unused tail is handed back below */
+        uint32_t space = bytes;
+        if (flags & HIMEM_FILE_COMPRESSED) space = HIMEM_LZ_BOUND(bytes);
+        if (flags & HIMEM_FILE_DELTA) space = HIMEM_DELTA_BOUND(bytes);
+        uint16_t page;
+        uint16_t offset;
+        bool append;
+        int room = reserveSpace(space, 1, page, offset, append);
+        if (room < 0) {
+            return room;
         }
     /* Save File Information */
-        int slot = fileIndex;
-        esp_err_t ret = esp_himem_map(memptr, rangeptr, lastPage * ESP_HIMEM_BLKSZ, 0, ESP_HIMEM_BLKSZ, 0, (void**)&records);
-        if (ret != ESP_OK) {
-            ESP_LOGE("writeFile", "Failed to map HIMEM for file info: %s", esp_err_to_name(ret));
+        uint32_t fileID = nextID;
+        int slot = fileID % HIMEM_RECORD_SLOTS;
+        if (!storeName(slot, fileName.c_str(), fileName.length())) {
             return static_cast<int>(HimemError::INITIALIZATION_FAILED);
         }
-        
-        records[slot].ID = slot;
-        records[slot].fileSize = bytes;
-        fileName.toCharArray(records[slot].filename, fileName.length() + 1);
-        records[slot].page = cPage;
-        records[slot].offset = cOffset;
-        
-        ret = esp_himem_unmap(rangeptr, records, ESP_HIMEM_BLKSZ);
-        if (ret != ESP_OK) {
-            ESP_LOGE("writeFile", "Failed to unmap HIMEM for file info: %s", esp_err_to_name(ret));
+        stampFile(slot);
+        record(slot).flags = flags | (checksums ? HIMEM_FILE_CRC : 0);
+        record(slot).rawSize = bytes;
+        record(slot).page = page;
+        record(slot).offset = offset;
+    /* Write File to HIMEM, the checksum is taken in the same pass as the copy */
+        uint32_t* crc = checksums ? &fileCrc(slot) : nullptr;
+        if (crc != nullptr) *crc = 0;
+        uint32_t stored = bytes;
+        bool written;
+        if (flags & HIMEM_FILE_COMPRESSED) {
+            written = copyInPacked(page, offset, buf, bytes, stored, crc);
+        } else if (flags & HIMEM_FILE_DELTA) {
+            written = copyInDelta(page, offset, buf, bytes, baseline, stored, crc);
+        } else {
+            written = true;
+            for (uint16_t i = 0; i < count && written; i++) {
+                written = copyIn(page, offset, segments[i].buf, segments[i].bytes, crc);
+            }
+        }
+        if (!written) {
             return static_cast<int>(HimemError::INITIALIZATION_FAILED);
         }
-        fileIndex++;
-    /* Write File to HIMEM */
-        uint32_t bytesToWrite = bytes;
-        uint32_t bufferOffset = 0;
-        
-        while (bytesToWrite > 0) {
-            uint8_t* ptr = nullptr;
-            ret = esp_himem_map(memptr, rangeptr, cPage * ESP_HIMEM_BLKSZ, 0, ESP_HIMEM_BLKSZ, 0, (void**)&ptr);
-            if (ret != ESP_OK) {
-                ESP_LOGE("writeFile", "Failed to map HIMEM page %d: %s", cPage, esp_err_to_name(ret));
-                return static_cast<int>(HimemError::INITIALIZATION_FAILED);
-            }
-            
-            uint32_t availableInPage = ESP_HIMEM_BLKSZ - cOffset;
-            uint32_t chunkSize = (bytesToWrite <= availableInPage) ? bytesToWrite : availableInPage;
-            
-            memcpy(ptr + cOffset, buf + bufferOffset, chunkSize);
-            
-            ret = esp_himem_unmap(rangeptr, ptr, ESP_HIMEM_BLKSZ);
-            if (ret != ESP_OK) {
-                ESP_LOGE("writeFile", "Failed to unmap HIMEM page %d: %s", cPage, esp_err_to_name(ret));
-                return static_cast<int>(HimemError::INITIALIZATION_FAILED);
-            }
-            
-            bytesToWrite -= chunkSize;
-            bufferOffset += chunkSize;
-            cOffset += chunkSize;
-            
-            // Move to next page if current page is full
-            if (cOffset >= ESP_HIMEM_BLKSZ) {
-                cPage++;
-                cOffset = 0;
-            }
+        record(slot).fileSize = stored;
+        writtenBytes += stored;
+        if (!append && space > stored) {
+            freeExtent((uint32_t)record(slot).page * ESP_HIMEM_BLKSZ + record(slot).offset + stored, space - stored);
         }
-        return (slot);
+        if (append) {
+            cPage = page;
+            cOffset = offset;
+        }
+    /* Publish the file, readers see it once nextID moves past it */
+        lockWindow();
+        indexInsert(slot);
+        unlockWindow();
+        markRecordDirty(slot);
+        nextID = fileID + 1;
+        return (int)fileID;
     }
 
     /* ----------------------------------------------------------- 
-    * Read File from HIMEM
-    * @param id - id assigned when file was create()d
-    * @param fileName - file name output to String
-    * @param buf - buffer to read file data into
-    * @return number of bytes read, 0 on error
+    * Write a burst of files in one call
+    * The files are checked and their space reserved up front, in one
+    * contiguous run, so their data goes into HIMEM back to back and each
+    * bank is mapped once. The records are published together and marked
+    * dirty as one range, so at most one record page update is made for the
+    * whole batch. Either all files are written or none.
+    * @param batch - files to write, stored as writeFile() without compression
+    * @param count - number of files in batch
+    * @return file ID of the first file, the others follow in order, negative on error
     ----------------------------------------------------------------*/
-    uint32_t HIMEM::readFile(int id, String &fileName, uint8_t* buf) {
-    /* Check for Initialization and Safety */
+    int HIMEM::writeFiles(const HimemBatchEntry* batch, uint16_t count) {
+        unsigned long start = micros();
+        int result = storeBatch(batch, count);
+        uint32_t bytes = 0;
+        for (uint16_t i = 0; i < count && result >= 0; i++) {
+            bytes += batch[i].bytes;
+        }
+        return countWrite(result, bytes, count, start);
+    }
+
+    /**
+     * Body of writeFiles(), without the statistics
+     */
+    int HIMEM::storeBatch(const HimemBatchEntry* batch, uint16_t count) {
         if (!isInitialized) {
-            ESP_LOGE("readFile", "HIMEM not initialized");
-            return 0;
+            ESP_LOGE("writeFiles", "HIMEM not initialized");
+            return static_cast<int>(HimemError::INITIALIZATION_FAILED);
         }
-        if (buf == nullptr) {
-            ESP_LOGE("readFile", "Buffer is null");
-            return 0;
+        if (batch == nullptr || count == 0) {
+            ESP_LOGE("writeFiles", "Empty batch");
+            return static_cast<int>(HimemError::INVALID_ID);
         }
-        
-    /* Check for Errors */
-        if (id < 0 || id >= fileIndex) {
-            ESP_LOGE("readFile", "Invalid file ID %d", id);
-            return 0;
+        if (count > MAX_HIMEM_FILES) {
+            ESP_LOGE("writeFiles", "Batch of %d files, maximum is %d", count, MAX_HIMEM_FILES);
+            return static_cast<int>(HimemError::MAX_HIMEM_FILES_REACHED);
         }
-    /* Locate File Record */
-        int slot = id;
-        esp_err_t ret = esp_himem_map(memptr, rangeptr, lastPage * ESP_HIMEM_BLKSZ, 0, ESP_HIMEM_BLKSZ, 0, (void**)&records);
-        if (ret != ESP_OK) {
-            ESP_LOGE("readFile", "Failed to map HIMEM for file info: %s", esp_err_to_name(ret));
-            return 0;
+        if (openID >= 0) {
+            ESP_LOGE("writeFiles", "File %d is open for writing", openID);
+            return static_cast<int>(HimemError::FILE_OPEN);
         }
-        
-        if ( records[slot].ID != id ) {
-            ESP_LOGE("readFile", "File ID mismatch expected ID %d, got ID %d", id, records[slot].ID);
-            esp_himem_unmap(rangeptr, records, ESP_HIMEM_BLKSZ);
-            return 0;
+        uint64_t total = 0;
+        for (uint16_t i = 0; i < count; i++) {
+            if (batch[i].buf == nullptr || batch[i].fileName == nullptr) {
+                ESP_LOGE("writeFiles", "Entry %d has no buffer or name", i);
+                return static_cast<int>(HimemError::INVALID_ID);
+            }
+            if (batch[i].bytes == 0) {
+                ESP_LOGE("writeFiles", "Entry %d has 0 bytes", i);
+                return static_cast<int>(HimemError::FILE_TOO_LARGE);
+            }
+            if (strlen(batch[i].fileName) >= MAX_HIMEM_FILENAME_LEN) {
+                ESP_LOGE("writeFiles", "File %s name too long, max is %d characters",
+                    batch[i].fileName, MAX_HIMEM_FILENAME_LEN - 1);
+                return static_cast<int>(HimemError::FILENAME_TOO_LONG);
+            }
+            total += batch[i].bytes;
         }
-    /* Retrieve File Information */
-        fileName = String(records[slot].filename);
-        uint32_t fileSize = records[slot].fileSize;
-        uint16_t currentPage = records[slot].page;
-        uint16_t currentOffset = records[slot].offset;
-        
-        ret = esp_himem_unmap(rangeptr, records, ESP_HIMEM_BLKSZ);
-        if (ret != ESP_OK) {
-            ESP_LOGE("readFile", "Failed to unmap HIMEM for file info: %s", esp_err_to_name(ret));
-            return 0;
+        if (total > himemSize) {
+            ESP_LOGE("writeFiles", "Batch is larger than HIMEM");
+            return static_cast<int>(HimemError::FILE_TOO_LARGE);
         }
-
-        uint32_t bufferOffset = 0;
-        uint32_t bytesToRead = fileSize;
-    /* Read File from HIMEM */
-        while (bytesToRead > 0) {
-            uint8_t* ptr = nullptr;
-            ret = esp_himem_map(memptr, rangeptr, currentPage * ESP_HIMEM_BLKSZ, 0, ESP_HIMEM_BLKSZ, 0, (void**)&ptr);
-            if (ret != ESP_OK) {
-                ESP_LOGE("readFile", "Failed to map HIMEM page %d: %s", currentPage, esp_err_to_name(ret));
-                return 0;
-            }
-            
-            uint32_t availableInPage = ESP_HIMEM_BLKSZ - currentOffset;
-            uint32_t chunkSize = (bytesToRead <= availableInPage) ? bytesToRead : availableInPage;
-            
-            memcpy(buf + bufferOffset, ptr + currentOffset, chunkSize);
-            
-            ret = esp_himem_unmap(rangeptr, ptr, ESP_HIMEM_BLKSZ);
-            if (ret != ESP_OK) {
-                ESP_LOGE("readFile", "Failed to unmap HIMEM page %d: %s", currentPage, esp_err_to_name(ret));
-                return 0;
+        uint16_t page;
+        uint16_t offset;
+        bool append;
+        int room = reserveSpace((uint32_t)total, count, page, offset, append);
+        if (room < 0) {
+            return room;
+        }
+    /* Write the data back to back, consecutive files share the mapped banks */
+        uint32_t firstFile = nextID;
+        for (uint16_t i = 0; i < count; i++) {
+            int slot = (firstFile + i) % HIMEM_RECORD_SLOTS;
+            if (!storeName(slot, batch[i].fileName, strlen(batch[i].fileName))) {
+                return static_cast<int>(HimemError::INITIALIZATION_FAILED);
             }
-            
-            bytesToRead -= chunkSize;
-            bufferOffset += chunkSize;
-            
-            // Move to next page if more data to read
-            if (bytesToRead > 0) {
-                currentPage++;
-                currentOffset = 0;  // Start from beginning of next page
+            stampFile(slot);
+            record(slot).flags = checksums ? HIMEM_FILE_CRC : 0;
+            record(slot).fileSize = batch[i].bytes;
+            record(slot).rawSize = batch[i].bytes;
+            record(slot).page = page;
+            record(slot).offset = offset;
+            fileCrc(slot) = 0;
+            if (!copyIn(page, offset, batch[i].buf, batch[i].bytes, checksums ? &fileCrc(slot) : nullptr)) {
+                return static_cast<int>(HimemError::INITIALIZATION_FAILED);
             }
         }
-        return fileSize;
+        writtenBytes += (uint32_t)total;
+        if (append) {
+            cPage = page;
+            cOffset = offset;
+        }
+    /* Publish the batch, readers see all of it once nextID moves past it */
+        lockWindow();
+        for (uint16_t i = 0; i < count; i++) {
+            indexInsert((firstFile + i) % HIMEM_RECORD_SLOTS);
+        }
+        unlockWindow();
+        for (uint16_t i = 0; i < count; i++) {
+            extendDirty((firstFile + i) % HIMEM_RECORD_SLOTS);
+        }
+        if (flushThreshold != 0 && dirtyCount >= flushThreshold) {
+            flushRecords();
+        }
+        nextID = firstFile + count;
+        return (int)firstFile;
     }
 
-    unsigned long HIMEM::freespace(void) {
-        if (!isInitialized) {
+    /* ----------------------------------------------------------- 
+    * Open a file to be written in pieces with appendFile()
+    * Data is copied straight into HIMEM at the current write position,
+    * no staging buffer for the whole file is needed. Only one file can
+    * be open; writeFile() is refused until it is closed.
+    * @param fileName - file name
+    * @return file ID the file will have, negative on error
+    ----------------------------------------------------------------*/
+    int HIMEM::openFile(String fileName) {
+        unsigned long start = micros();
+        return countWrite(startFile(fileName), 0, 0, start);
+    }
+
+    /**
+     * Body of openFile(), without the statistics
+     */
+    int HIMEM::startFile(String& fileName) {
+        if (!isInitialized) {
+            ESP_LOGE("openFile", "HIMEM not initialized");
+            return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+        }
+        if (fileName.length() >= MAX_HIMEM_FILENAME_LEN) {
+            ESP_LOGE("openFile", "File %s name too long, max is %d characters", 
+                fileName.c_str(), MAX_HIMEM_FILENAME_LEN - 1);
+            return static_cast<int>(HimemError::FILENAME_TOO_LONG);
+        }
+        if (openID >= 0) {
+            ESP_LOGE("openFile", "File %d is already open for writing", openID);
+            return static_cast<int>(HimemError::FILE_OPEN);
+        }
+        int room = makeRoom(0, 0, 1);
+        if (room < 0) {
+            return room;
+        }
+    /* Reserve the record, it is published by closeFile() */
+        uint32_t fileID = nextID;
+        int slot = fileID % HIMEM_RECORD_SLOTS;
+        if (!storeName(slot, fileName.c_str(), fileName.length())) {
+            return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+        }
+        stampFile(slot);
+        record(slot).flags = checksums ? HIMEM_FILE_CRC : 0;
+        record(slot).fileSize = 0;
+        record(slot).rawSize = 0;
+        fileCrc(slot) = 0;
+        record(slot).page = cPage;
+        record(slot).offset = cOffset;
+        openID = fileID;
+        return (int)fileID;
+    }
+
+    /* ----------------------------------------------------------- 
+    * Append data to the file opened with openFile()
+    * @param id - ID returned by openFile()
+    * @param buf - data to append
+    * @param bytes - number of bytes to append
+    * @return SUCCESS, negative on error
+    ----------------------------------------------------------------*/
+    int HIMEM::appendFile(int id, const uint8_t* buf, uint32_t bytes) {
+        unsigned long start = micros();
+        return countWrite(appendData(id, buf, bytes), 0, 0, start);
+    }
+
+    /**
+     * Body of appendFile(), without the statistics
+     */
+    int HIMEM::appendData(int id, const uint8_t* buf, uint32_t bytes) {
+        if (!isInitialized) {
+            ESP_LOGE("appendFile", "HIMEM not initialized");
+            return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+        }
+        if (openID < 0 || id != openID) {
+            ESP_LOGE("appendFile", "File %d is not open for writing", id);
+            return static_cast<int>(HimemError::INVALID_ID);
+        }
+        if (buf == nullptr) {
+            ESP_LOGE("appendFile", "Buffer pointer is null");
+            return static_cast<int>(HimemError::INVALID_ID);
+        }
+        if (bytes == 0) {
+            return static_cast<int>(HimemError::SUCCESS);
+        }
+        int slot = openID % HIMEM_RECORD_SLOTS;
+        int room = makeRoom(bytes, record(slot).fileSize + bytes, 0);
+        if (room < 0) {
+            return room;
+        }
+        if (!fifoMode && wilderness() < bytes) {
+            ESP_LOGE("appendFile", "Only holes left, an open file cannot grow into them");
+            return static_cast<int>(HimemError::INSUFFICIENT_MEMORY);
+        }
+        record(slot).fileSize += bytes;
+        record(slot).rawSize += bytes;
+        writtenBytes += bytes;
+        uint32_t* crc = (record(slot).flags & HIMEM_FILE_CRC) ? &fileCrc(slot) : nullptr;
+        if (!copyIn(cPage, cOffset, buf, bytes, crc)) {
+            return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+        }
+        return static_cast<int>(HimemError::SUCCESS);
+    }
+
+    /* ----------------------------------------------------------- 
+    * Close the file opened with openFile() and commit its size
+    * A file closed without data is discarded.
+    * @param id - ID returned by openFile()
+    * @return file Id number, negative on error
+    ----------------------------------------------------------------*/
+    int HIMEM::closeFile(int id) {
+        unsigned long start = micros();
+        int result = finishFile(id);
+        uint32_t bytes = (result >= 0) ? record(result % HIMEM_RECORD_SLOTS).rawSize : 0;
+        return countWrite(result, bytes, 1, start);
+    }
+
+    /**
+     * Body of closeFile(), without the statistics
+     */
+    int HIMEM::finishFile(int id) {
+        if (!isInitialized) {
+            ESP_LOGE("closeFile", "HIMEM not initialized");
+            return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+        }
+        if (openID < 0 || id != openID) {
+            ESP_LOGE("closeFile", "File %d is not open for writing", id);
+            return static_cast<int>(HimemError::INVALID_ID);
+        }
+        int slot = openID % HIMEM_RECORD_SLOTS;
+        openID = -1;
+        if (record(slot).fileSize == 0) {
+            absorbWilderness();
+            ESP_LOGW("closeFile", "File %d closed without data, discarded", id);
+            return static_cast<int>(HimemError::FILE_TOO_LARGE);
+        }
+        lockWindow();
+        indexInsert(slot);
+        unlockWindow();
+        markRecordDirty(slot);
+        nextID = id + 1;
+        return id;
+    }
+
+    /* ----------------------------------------------------------- 
+    * Check there is room for more data, in FIFO mode retire the oldest
+    * files until there is. In concurrent mode only the reader retires
+    * files, so a full store fails here until it calls releaseFile().
+    * @param bytes - bytes about to be written
+    * @param fileBytes - size the file will have once they are written
+    * @param newRecords - file records needed as well
+    * @return SUCCESS, negative on error
+    ----------------------------------------------------------------*/
+    int HIMEM::makeRoom(uint32_t bytes, uint32_t fileBytes, uint16_t newRecords) {
+        if (fifoMode) {
+            if (fileBytes > (unsigned long)dataPages() * ESP_HIMEM_BLKSZ) {
+                ESP_LOGE("writeFile", "File is larger than the FIFO");
+                return static_cast<int>(HimemError::FILE_TOO_LARGE);
+            }
+            // Records first, a new record bank comes out of the data pages
+            while (!concurrent && slotsUsed() > 0 &&
+                   (!reserveRecords(newRecords) || freespace() < bytes)) {
+                retireOldest();
+            }
+        }
+        if (!reserveRecords(newRecords)) {
+            if (!concurrent && slotsUsed() + newRecords > MAX_HIMEM_FILES) {
+                ESP_LOGE("writeFile", "Maximum number of files %d reached", MAX_HIMEM_FILES);
+            } else if (!concurrent) {
+                ESP_LOGE("writeFile", "No free HIMEM bank for more file records, %d files stored", getFileCount());
+            }
+            return static_cast<int>(HimemError::MAX_HIMEM_FILES_REACHED);
+        }
+        if (freespace() < bytes) {
+            if (!concurrent) {
+                ESP_LOGE("writeFile", "File is larger than available HIMEM");
+            }
+            return static_cast<int>(HimemError::INSUFFICIENT_MEMORY);
+        }
+        return static_cast<int>(HimemError::SUCCESS);
+    }
+
+    /* ----------------------------------------------------------- 
+    * Make room for space bytes and newRecords records and choose where they go:
+    * the best fit hole left by deleteFile(), else the end of the stored data
+    * @param append - set when the space is at the end of the stored data
+    * @return SUCCESS, negative on error
+    ----------------------------------------------------------------*/
+    int HIMEM::reserveSpace(uint32_t space, uint16_t newRecords, uint16_t& page, uint16_t& offset, bool& append) {
+        int room = makeRoom(space, space, newRecords);
+        if (room < 0) {
+            return room;
+        }
+        page = cPage;
+        offset = cOffset;
+        append = true;
+        if (extentCount > 0) {
+            if (!settleMove()) {
+                return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+            }
+            uint32_t addr;
+            if (takeExtent(space, addr)) {
+                page = addr / ESP_HIMEM_BLKSZ;
+                offset = addr % ESP_HIMEM_BLKSZ;
+                append = false;
+            } else if (wilderness() < space) {
+                compactAll();
+                if (wilderness() < space) {
+                    ESP_LOGE("writeFile", "Could not compact HIMEM to make room");
+                    return static_cast<int>(HimemError::INSUFFICIENT_MEMORY);
+                }
+                page = cPage;
+                offset = cOffset;
+            }
+        }
+        return static_cast<int>(HimemError::SUCCESS);
+    }
+
+    /* ----------------------------------------------------------- 
+    * Copy data into HIMEM at page/offset, usually the write position
+    * cPage/cOffset, and advance it, wrapping to page 0 in FIFO mode
+    * @param crc - if set, the CRC-32 is carried on from it over the data as it is copied
+    * @return false if a page could not be mapped
+    ----------------------------------------------------------------*/
+    bool HIMEM::copyIn(uint16_t& page, uint16_t& offset, const uint8_t* buf, uint32_t bytes, uint32_t* crc) {
+        uint32_t bytesToWrite = bytes;
+        uint32_t bufferOffset = 0;
+        
+        unsigned int end = regionEnd(page);
+        while (bytesToWrite > 0) {
+            lockWindow();
+            unsigned int banks = 0;
+            uint8_t* ptr = pagePtr(page, &banks);
+            if (ptr == nullptr) {
+                unlockWindow();
+                ESP_LOGE("writeFile", "Failed to map HIMEM page %d", page);
+                return false;
+            }
+            
+            // Copy as much as the resident window holds, possibly several banks at once.
+            // In concurrent mode the lock is dropped after every bank so the reader can get in
+            if (banks > end - page) banks = end - page;
+            if (concurrent) banks = 1;
+            uint32_t availableInWindow = banks * ESP_HIMEM_BLKSZ - offset;
+            uint32_t chunkSize = (bytesToWrite <= availableInWindow) ? bytesToWrite : availableInWindow;
+            
+            if (crc != nullptr) {
+                *crc = crc32Copy(*crc, ptr + offset, buf + bufferOffset, chunkSize);
+            } else {
+                memcpy(ptr + offset, buf + bufferOffset, chunkSize);
+            }
+            unlockWindow();
+            
+            bytesToWrite -= chunkSize;
+            bufferOffset += chunkSize;
+            
+            // Move to the page that holds the next free byte
+            uint32_t nextOffset = offset + chunkSize;
+            page += nextOffset / ESP_HIMEM_BLKSZ;
+            offset = nextOffset % ESP_HIMEM_BLKSZ;
+            if (fifoMode && page >= end) {
+                page = 0;                          // FIFO wraps to the first data page
+            }
+        }
+        return true;
+    }
+
+    /* ----------------------------------------------------------- 
+    * Compress data into HIMEM at page/offset one HIMEM_LZ_BLOCK at a time
+    * and advance page/offset like copyIn(). A block is compressed straight
+    * into the mapped window when the window has room for it, otherwise
+    * through the internal scratch block. Blocks that do not compress are
+    * stored raw.
+    * @param stored - set to the bytes written to HIMEM
+    * @return false if a page could not be mapped or the scratch block allocated
+    ----------------------------------------------------------------*/
+    bool HIMEM::copyInPacked(uint16_t& page, uint16_t& offset, const uint8_t* buf, uint32_t bytes, uint32_t& stored,
+                             uint32_t* crc) {
+        if (!allocScratch(packBuf, (sizeof(uint16_t) << HIMEM_LZ_HASH_BITS) + HIMEM_LZ_HEADER + HIMEM_LZ_BLOCK, "writeFile")) {
+            return false;
+        }
+        uint16_t* table = (uint16_t*)packBuf;
+        uint8_t* pack = packBuf + (sizeof(uint16_t) << HIMEM_LZ_HASH_BITS);
+        unsigned int end = regionEnd(page);
+        stored = 0;
+
+        for (uint32_t done = 0; done < bytes; ) {
+            uint32_t blockBytes = (bytes - done < HIMEM_LZ_BLOCK) ? bytes - done : HIMEM_LZ_BLOCK;
+            const uint8_t* block = buf + done;
+            done += blockBytes;
+
+            lockWindow();
+            unsigned int banks = 0;
+            uint8_t* ptr = pagePtr(page, &banks);
+            if (ptr == nullptr) {
+                unlockWindow();
+                ESP_LOGE("writeFile", "Failed to map HIMEM page %d", page);
+                return false;
+            }
+            if (banks > end - page) banks = end - page;
+            if (concurrent) banks = 1;
+            if (banks * ESP_HIMEM_BLKSZ - offset >= HIMEM_LZ_HEADER + blockBytes) {
+                // The whole block fits in the window, compress in place
+                uint8_t* out = ptr + offset;
+                uint32_t packed = lzCompress(block, blockBytes, out + HIMEM_LZ_HEADER, table);
+                uint16_t header = packed;
+                if (packed == 0) {
+                    if (crc != nullptr) {
+                        *crc = crc32Copy(*crc, out + HIMEM_LZ_HEADER, block, blockBytes);
+                    } else {
+                        memcpy(out + HIMEM_LZ_HEADER, block, blockBytes);
+                    }
+                    header = HIMEM_LZ_RAW | blockBytes;
+                    packed = blockBytes;
+                } else if (crc != nullptr) {
+                    *crc = crc32(*crc, block, blockBytes);      // block is still in cache from lzCompress()
+                }
+                out[0] = (uint8_t)header;
+                out[1] = (uint8_t)(header >> 8);
+                unlockWindow();
+                uint32_t nextOffset = offset + HIMEM_LZ_HEADER + packed;
+                page += nextOffset / ESP_HIMEM_BLKSZ;
+                offset = nextOffset % ESP_HIMEM_BLKSZ;
+                if (fifoMode && page >= end) {
+                    page = 0;
+                }
+                stored += HIMEM_LZ_HEADER + packed;
+                continue;
+            }
+            unlockWindow();
+
+            // The block crosses the end of the window, compress to the scratch block and copy it in
+            uint32_t packed = lzCompress(block, blockBytes, pack + HIMEM_LZ_HEADER, table);
+            uint16_t header = packed ? packed : HIMEM_LZ_RAW | blockBytes;
+            pack[0] = (uint8_t)header;
+            pack[1] = (uint8_t)(header >> 8);
+            if (packed && crc != nullptr) {
+                *crc = crc32(*crc, block, blockBytes);
+            }
+            bool copied = packed ? copyIn(page, offset, pack, HIMEM_LZ_HEADER + packed)
+                                 : copyIn(page, offset, pack, HIMEM_LZ_HEADER) && copyIn(page, offset, block, blockBytes, crc);
+            if (!copied) {
+                return false;
+            }
+            stored += HIMEM_LZ_HEADER + (packed ? packed : blockBytes);
+        }
+        return true;
+    }
+
+    /**
+     * Allocate an internal RAM scratch buffer on first use, logs under tag on failure
+     */
+    bool HIMEM::allocScratch(uint8_t*& buf, size_t bytes, const char* tag) {
+        if (buf == nullptr) {
+            buf = (uint8_t*)heap_caps_malloc(bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+            if (buf == nullptr) {
+                ESP_LOGE(tag, "Failed to allocate %u byte scratch buffer", (unsigned int)bytes);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * State of a piece of a delta file being encoded, diffChunk() compares it to the baseline
+     */
+    struct HimemDiff {
+        const uint8_t* frame;                       // piece of the new file
+        uint8_t* out;                               // encoded runs
+        uint32_t outBytes;
+        uint32_t at;                                // frame bytes compared so far
+        uint32_t litStart;                          // first frame byte not yet encoded
+        uint32_t runStart;                          // start of the unchanged run being scanned
+        bool inRun;
+    };
+
+    static inline uint32_t load32(const uint8_t* p) {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static void putToken(HimemDiff* diff, uint16_t token) {
+        diff->out[diff->outBytes++] = (uint8_t)token;
+        diff->out[diff->outBytes++] = (uint8_t)(token >> 8);
+    }
+
+    static void putLiteral(HimemDiff* diff, uint32_t from, uint32_t to) {
+        if (to > from) {
+            putToken(diff, HIMEM_DELTA_LITERAL | (to - from));
+            memcpy(diff->out + diff->outBytes, diff->frame + from, to - from);
+            diff->outBytes += to - from;
+        }
+    }
+
+    /**
+     * Emit the unchanged run that ends at end if it is long enough to be worth a token
+     */
+    static void endRun(HimemDiff* diff, uint32_t end) {
+        if (end - diff->runStart >= HIMEM_DELTA_MIN_RUN) {
+            putLiteral(diff, diff->litStart, diff->runStart);
+            putToken(diff, end - diff->runStart);
+            diff->litStart = end;
+        }
+        diff->inRun = false;
+    }
+
+    /**
+     * Sink that compares a chunk of the baseline, still in the map window, with the new file
+     */
+    bool HIMEM::diffChunk(const uint8_t* data, uint32_t bytes, void* context) {
+        HimemDiff* diff = (HimemDiff*)context;
+        const uint8_t* frame = diff->frame + diff->at;
+        uint32_t i = 0;
+        while (i < bytes) {
+            if (diff->inRun) {
+                while (i + 4 <= bytes && load32(frame + i) == load32(data + i)) i += 4;
+                while (i < bytes && frame[i] == data[i]) i++;
+                if (i < bytes) {
+                    endRun(diff, diff->at + i);
+                }
+            } else {
+                while (i < bytes && frame[i] != data[i]) i++;
+                if (i < bytes) {
+                    diff->inRun = true;
+                    diff->runStart = diff->at + i;
+                }
+            }
+        }
+        diff->at += bytes;
+        return true;
+    }
+
+    /* ----------------------------------------------------------- 
+    * Write data into HIMEM at page/offset as runs against a baseline slot
+    * and advance page/offset like copyIn(). Each HIMEM_DELTA_PIECE of the
+    * data is compared with the baseline in the map window and encoded as
+    * 2 byte tokens, bit 15 set for a run of new bytes that follow the
+    * token, clear for a run of baseline bytes. The stream starts with the
+    * baseline slot and its write stamp.
+    * @param stored - set to the bytes written to HIMEM
+    * @return false if a page could not be mapped or the scratch block allocated
+    ----------------------------------------------------------------*/
+    bool HIMEM::copyInDelta(uint16_t& page, uint16_t& offset, const uint8_t* buf, uint32_t bytes, int baseline, uint32_t& stored,
+                            uint32_t* crc) {
+        if (!allocScratch(packBuf, (sizeof(uint16_t) << HIMEM_LZ_HASH_BITS) + HIMEM_LZ_HEADER + HIMEM_LZ_BLOCK, "writeDelta")) {
+            return false;
+        }
+        uint8_t* out = packBuf + (sizeof(uint16_t) << HIMEM_LZ_HASH_BITS);    // room for a piece and its token
+        uint32_t stamp = baselineState[baseline].stamp;
+        uint8_t header[HIMEM_DELTA_HEADER] = {(uint8_t)baseline, 0, (uint8_t)stamp, (uint8_t)(stamp >> 8),
+                                              (uint8_t)(stamp >> 16), (uint8_t)(stamp >> 24)};
+        if (!copyIn(page, offset, header, HIMEM_DELTA_HEADER)) {
+            return false;
+        }
+        stored = HIMEM_DELTA_HEADER;
+
+        uint32_t baseAddr = baselinePage(baseline) * ESP_HIMEM_BLKSZ + sizeof(struct_HIMEM_BaselineInfo);
+        uint32_t baseBytes = baselineState[baseline].bytes;
+        for (uint32_t pos = 0; pos < bytes; pos += HIMEM_DELTA_PIECE) {
+            uint32_t pieceBytes = (bytes - pos < HIMEM_DELTA_PIECE) ? bytes - pos : HIMEM_DELTA_PIECE;
+            uint32_t compare = (pos >= baseBytes) ? 0 : (baseBytes - pos < pieceBytes) ? baseBytes - pos : pieceBytes;
+            HimemDiff diff = {buf + pos, out, 0, 0, 0, 0, false};
+            if (compare > 0) {
+                uint32_t addr = baseAddr + pos;
+                if (walkRange(addr / ESP_HIMEM_BLKSZ, addr % ESP_HIMEM_BLKSZ, compare, diffChunk, &diff) != compare) {
+                    return false;
+                }
+                if (diff.inRun) {
+                    endRun(&diff, compare);
+                }
+            }
+            putLiteral(&diff, diff.litStart, pieceBytes);   // changed bytes and anything past the end of the baseline
+            if (crc != nullptr) {
+                *crc = crc32(*crc, buf + pos, pieceBytes);  // the piece is still in cache from the compare
+            }
+            if (!copyIn(page, offset, out, diff.outBytes)) {
+                return false;
+            }
+            stored += diff.outBytes;
+        }
+        return true;
+    }
+
+    /* ----------------------------------------------------------- 
+    * Read File from HIMEM
+    * @param id - id assigned when file was create()d
+    * @param fileName - file name output to String
+    * @param buf - buffer to read file data into
+    * @return number of bytes read, 0 on error
+    ----------------------------------------------------------------*/
+    uint32_t HIMEM::readFile(int id, String &fileName, uint8_t* buf) {
+        unsigned long start = micros();
+        return countRead(fetchFile(id, fileName, buf), start);
+    }
+
+    /**
+     * Body of readFile(id, fileName, buf), without the statistics
+     */
+    uint32_t HIMEM::fetchFile(int id, String &fileName, uint8_t* buf) {
+    /* Check for Initialization and Safety */
+        if (!isInitialized) {
+            ESP_LOGE("readFile", "HIMEM not initialized");
+            return 0;
+        }
+        if (buf == nullptr) {
+            ESP_LOGE("readFile", "Buffer is null");
+            return 0;
+        }
+        
+    /* Locate File Record */
+        int slot = findSlot(id, "readFile");
+        if (slot < 0) {
+            return 0;
+        }
+        fileName = String(this->fileName(slot));
+    /* Read File from HIMEM */
+        uint8_t* cursor = buf;
+        uint32_t bytesRead = walkChecked(slot, copyChunk, &cursor);
+        return (bytesRead == record(slot).rawSize) ? bytesRead : 0;
+    }
+
+    /**
+     * Progress of readFile() through its segments, kept for scatterChunk()
+     */
+    struct HimemScatter {
+        const HimemSegment* segments;
+        uint16_t count;
+        uint16_t index;                             // segment being filled
+        uint32_t offset;                            // bytes of it filled
+        uint32_t* crc;                              // CRC-32 taken while copying, nullptr if the file has none
+    };
+
+    /* ----------------------------------------------------------- 
+    * Read File from HIMEM scattered into several buffers, e.g. the
+    * header and payload of a frame into separate places. Each mapped
+    * chunk is copied straight into the segments, filled in order.
+    * @param fileName - file name output to String
+    * @param segments - buffers that together hold at least the file size
+    * @param count - number of segments
+    * @return number of bytes read, 0 on error
+    ----------------------------------------------------------------*/
+    uint32_t HIMEM::readFile(int id, String &fileName, const HimemSegment* segments, uint16_t count) {
+        unsigned long start = micros();
+        return countRead(fetchFile(id, fileName, segments, count), start);
+    }
+
+    /**
+     * Body of readFile(id, fileName, segments, count), without the statistics
+     */
+    uint32_t HIMEM::fetchFile(int id, String &fileName, const HimemSegment* segments, uint16_t count) {
+        if (!isInitialized) {
+            ESP_LOGE("readFile", "HIMEM not initialized");
+            return 0;
+        }
+        if (segments == nullptr || count == 0) {
+            ESP_LOGE("readFile", "No segments");
+            return 0;
+        }
+        int slot = findSlot(id, "readFile");
+        if (slot < 0) {
+            return 0;
+        }
+        uint64_t room = 0;
+        for (uint16_t i = 0; i < count; i++) {
+            room += (segments[i].buf != nullptr) ? segments[i].bytes : 0;
+        }
+        if (room < record(slot).rawSize) {
+            ESP_LOGE("readFile", "Segments hold %u bytes, file %d is %u", (unsigned int)room, id, record(slot).rawSize);
+            return 0;
+        }
+        fileName = String(this->fileName(slot));
+        uint32_t crc = 0;
+        HimemScatter scatter = {segments, count, 0, 0, (record(slot).flags & HIMEM_FILE_CRC) ? &crc : nullptr};
+        uint32_t bytesRead = walkFile(slot, scatterChunk, &scatter);
+        if (bytesRead != record(slot).rawSize || (scatter.crc != nullptr && !checkCrc(slot, crc, "readFile"))) {
+            return 0;
+        }
+        return bytesRead;
+    }
+
+    /* ----------------------------------------------------------- 
+    * Read File from HIMEM in chunks
+    * The sink is called with data straight from the mapped window, one
+    * call per window (up to ESP_HIMEM_BLKSZ bytes per bank), so no
+    * buffer for the whole file is needed. The sink must not call back
+    * into this HIMEM object.
+    * @param id - file ID
+    * @param sink - called for each chunk, return false to stop reading
+    * @param context - passed to the sink
+    * @return number of bytes delivered to the sink, 0 on error or if the
+    *         file does not match its checksum, which is only known once
+    *         the sink has had all of it
+    ----------------------------------------------------------------*/
+    uint32_t HIMEM::readFile(int id, HimemChunkCallback sink, void* context) {
+        unsigned long start = micros();
+        return countRead(fetchFile(id, sink, context), start);
+    }
+
+    /**
+     * Body of readFile(id, sink, context), without the statistics
+     */
+    uint32_t HIMEM::fetchFile(int id, HimemChunkCallback sink, void* context) {
+        if (!isInitialized) {
+            ESP_LOGE("readFile", "HIMEM not initialized");
+            return 0;
+        }
+        if (sink == nullptr) {
+            ESP_LOGE("readFile", "Sink is null");
+            return 0;
+        }
+        int slot = findSlot(id, "readFile");
+        if (slot < 0) {
+            return 0;
+        }
+        return walkChecked(slot, sink, context);
+    }
+
+    /* ----------------------------------------------------------- 
+    * Read File from HIMEM into an Arduino Print/Stream (SD File, WiFiClient, ...)
+    * @param id - file ID
+    * @param out - destination, written one mapped chunk at a time
+    * @return number of bytes written, less than the file size if out stopped accepting data
+    ----------------------------------------------------------------*/
+    uint32_t HIMEM::readFile(int id, Print &out) {
+        return readFile(id, printChunk, &out);
+    }
+
+    /**
+     * Chunk sinks used by the readFile() variants
+     */
+
+    bool HIMEM::copyChunk(const uint8_t* data, uint32_t bytes, void* context) {
+        uint8_t** cursor = (uint8_t**)context;
+        memcpy(*cursor, data, bytes);
+        *cursor += bytes;
+        return true;
+    }
+
+    bool HIMEM::scatterChunk(const uint8_t* data, uint32_t bytes, void* context) {
+        HimemScatter* scatter = (HimemScatter*)context;
+        while (bytes > 0) {
+            if (scatter->index == scatter->count) {
+                return false;                       // more data than the segments hold
+            }
+            const HimemSegment& segment = scatter->segments[scatter->index];
+            uint32_t room = (segment.buf != nullptr) ? segment.bytes - scatter->offset : 0;
+            uint32_t take = (bytes < room) ? bytes : room;
+            if (take > 0) {
+                if (scatter->crc != nullptr) {
+                    *scatter->crc = crc32Copy(*scatter->crc, segment.buf + scatter->offset, data, take);
+                } else {
+                    memcpy(segment.buf + scatter->offset, data, take);
+                }
+                data += take;
+                bytes -= take;
+                scatter->offset += take;
+            }
+            if (take == room) {
+                scatter->index++;
+                scatter->offset = 0;
+            }
+        }
+        return true;
+    }
+
+    bool HIMEM::printChunk(const uint8_t* data, uint32_t bytes, void* context) {
+        Print* out = (Print*)context;
+        return out->write(data, bytes) == bytes;
+    }
+
+    /**
+     * Sink of a file being read with its checksum taken on the way, see walkChecked()
+     */
+    struct HimemCheck {
+        HimemChunkCallback sink;                    // nullptr to only take the checksum
+        void* context;
+        uint32_t crc;
+    };
+
+    /**
+     * Take the CRC of a chunk and pass it on, a copyChunk() copy is made in the same pass
+     */
+    bool HIMEM::checkChunk(const uint8_t* data, uint32_t bytes, void* context) {
+        HimemCheck* check = (HimemCheck*)context;
+        if (check->sink == copyChunk) {
+            uint8_t** cursor = (uint8_t**)check->context;
+            check->crc = crc32Copy(check->crc, *cursor, data, bytes);
+            *cursor += bytes;
+            return true;
+        }
+        check->crc = crc32(check->crc, data, bytes);
+        return check->sink == nullptr || check->sink(data, bytes, check->context);
+    }
+
+    /**
+     * True for sinks that only copy into the caller's memory and can be called
+     * with the window locked, other sinks get the bounce buffer in concurrent mode
+     */
+    bool HIMEM::directSink(HimemChunkCallback sink, void* context) {
+        if (sink == checkChunk) {
+            HimemCheck* check = (HimemCheck*)context;
+            return check->sink == nullptr || directSink(check->sink, check->context);
+        }
+        return sink == copyChunk || sink == scatterChunk;
+    }
+
+    /* ----------------------------------------------------------- 
+    * Check a file against the CRC-32 taken when it was written, e.g.
+    * before a frame is written to the SD card or from an idle task.
+    * Compressed and delta files are checked on their original data.
+    * @param id - file ID, written with setChecksums(true)
+    * @return SUCCESS, CHECKSUM_MISMATCH, negative on other errors
+    ----------------------------------------------------------------*/
+    int HIMEM::verifyFile(int id) {
+        if (!isInitialized) {
+            ESP_LOGE("verifyFile", "HIMEM not initialized");
+            return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+        }
+        int slot = findSlot(id, "verifyFile");
+        if (slot < 0) {
+            return static_cast<int>(HimemError::INVALID_ID);
+        }
+        if (!(record(slot).flags & HIMEM_FILE_CRC)) {
+            ESP_LOGE("verifyFile", "File %d was written without a checksum", id);
+            return static_cast<int>(HimemError::INVALID_ID);
+        }
+        HimemCheck check = {nullptr, nullptr, 0};
+        if (walkFile(slot, checkChunk, &check) != record(slot).rawSize) {
+            ESP_LOGE("verifyFile", "File %d could not be read", id);
+            return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+        }
+        if (!checkCrc(slot, check.crc, "verifyFile")) {
+            return static_cast<int>(HimemError::CHECKSUM_MISMATCH);
+        }
+        return static_cast<int>(HimemError::SUCCESS);
+    }
+
+    /**
+     * State of a compressed file being read, blocks can span the chunks walkRange() hands out
+     */
+    struct HimemUnpack {
+        HimemChunkCallback sink;
+        void* context;
+        uint8_t* staged;                            // compressed block assembled across chunks
+        uint8_t* out;                               // decompressed block for sinks other than copyChunk
+        uint32_t remaining;                         // original bytes still to come
+        uint32_t delivered;                         // original bytes accepted by the sink
+        uint16_t header;
+        uint8_t headerBytes;
+        uint32_t have;
+        uint32_t need;
+    };
+
+    /**
+     * Sink that decompresses a file block by block and passes the result to the caller's sink
+     */
+    bool HIMEM::unpackChunk(const uint8_t* data, uint32_t bytes, void* context) {
+        HimemUnpack* state = (HimemUnpack*)context;
+        while (bytes > 0) {
+            if (state->headerBytes < HIMEM_LZ_HEADER) {
+                state->header |= (uint16_t)(*data++) << (8 * state->headerBytes++);
+                bytes--;
+                if (state->headerBytes == HIMEM_LZ_HEADER) {
+                    state->need = state->header & ~HIMEM_LZ_RAW;
+                    state->have = 0;
+                    uint32_t outBytes = (state->remaining < HIMEM_LZ_BLOCK) ? state->remaining : HIMEM_LZ_BLOCK;
+                    bool raw = state->header & HIMEM_LZ_RAW;
+                    if (raw ? state->need != outBytes : state->need == 0 || state->need >= outBytes) {
+                        ESP_LOGE("readFile", "Corrupt compressed block header 0x%04x", state->header);
+                        return false;
+                    }
+                }
+                continue;
+            }
+            // Decode straight from the chunk when the whole block is in it
+            uint32_t take = state->need - state->have;
+            if (take > bytes) take = bytes;
+            const uint8_t* block = data;
+            if (state->have > 0 || take < state->need) {
+                memcpy(state->staged + state->have, data, take);
+                block = state->staged;
+            }
+            state->have += take;
+            data += take;
+            bytes -= take;
+            if (state->have < state->need) {
+                continue;
+            }
+            uint32_t outBytes = (state->remaining < HIMEM_LZ_BLOCK) ? state->remaining : HIMEM_LZ_BLOCK;
+            if (state->header & HIMEM_LZ_RAW) {
+                if (!state->sink(block, outBytes, state->context)) {
+                    return false;
+                }
+            } else if (state->sink == copyChunk) {
+                uint8_t** cursor = (uint8_t**)state->context;
+                if (!lzDecompress(block, state->need, *cursor, outBytes)) {
+                    ESP_LOGE("readFile", "Corrupt compressed block");
+                    return false;
+                }
+                *cursor += outBytes;
+            } else {
+                if (!lzDecompress(block, state->need, state->out, outBytes)) {
+                    ESP_LOGE("readFile", "Corrupt compressed block");
+                    return false;
+                }
+                if (!state->sink(state->out, outBytes, state->context)) {
+                    return false;
+                }
+            }
+            state->remaining -= outBytes;
+            state->delivered += outBytes;
+            state->header = 0;
+            state->headerBytes = 0;
+        }
+        return true;
+    }
+
+    /**
+     * Record slot for a readable file, logs under tag and returns -1 if there is none
+     */
+    int HIMEM::findSlot(int id, const char* tag) {
+        int slot = slotForID(id);
+        if (slot < 0) {
+            ESP_LOGE(tag, "Invalid file ID %d", id);
+            return -1;
+        }
+        return slot;
+    }
+
+    /**
+     * State of a delta file being rebuilt, out holds frame bytes base to end
+     */
+    struct HimemPatch {
+        uint8_t* out;
+        uint32_t base;
+        uint32_t pos;                               // next frame byte to rebuild
+        uint32_t end;
+        uint32_t baseBytes;                         // frame bytes the baseline covers
+        uint32_t consumed;                          // stream bytes read so far
+        uint32_t run;                               // bytes left in the current token's run
+        uint16_t token;
+        uint8_t tokenBytes;
+        bool corrupt;
+    };
+
+    /**
+     * Sink that applies the runs of a delta stream to frame bytes prefilled from the baseline,
+     * stops at the end of the piece being rebuilt
+     */
+    bool HIMEM::patchChunk(const uint8_t* data, uint32_t bytes, void* context) {
+        HimemPatch* patch = (HimemPatch*)context;
+        uint32_t i = 0;
+        while (i < bytes) {
+            if (patch->run == 0) {
+                if (patch->pos == patch->end) {
+                    return false;
+                }
+                patch->token |= (uint16_t)data[i++] << (8 * patch->tokenBytes++);
+                patch->consumed++;
+                if (patch->tokenBytes < 2) {
+                    continue;
+                }
+                patch->run = patch->token & ~HIMEM_DELTA_LITERAL;
+                bool literal = patch->token & HIMEM_DELTA_LITERAL;
+                if (patch->run == 0 || patch->pos + patch->run > patch->end ||
+                    (!literal && patch->pos + patch->run > patch->baseBytes)) {
+                    ESP_LOGE("readFile", "Corrupt delta run 0x%04x at byte %u", patch->token, patch->pos);
+                    patch->corrupt = true;
+                    return false;
+                }
+                if (!literal) {
+                    patch->pos += patch->run;               // baseline bytes are already in place
+                    patch->run = 0;
+                }
+                patch->token = literal ? patch->token : 0;
+                patch->tokenBytes = literal ? 2 : 0;
+                continue;
+            }
+            uint32_t take = (bytes - i < patch->run) ? bytes - i : patch->run;
+            memcpy(patch->out + patch->pos - patch->base, data + i, take);
+            i += take;
+            patch->consumed += take;
+            patch->pos += take;
+            patch->run -= take;
+            if (patch->run == 0) {
+                patch->token = 0;
+                patch->tokenBytes = 0;
+            }
+        }
+        return true;
+    }
+
+    /* ----------------------------------------------------------- 
+    * Rebuild a delta file from its baseline slot and stored runs
+    * For copyChunk the baseline is copied into the caller's buffer and the
+    * runs applied on top in one pass each. Other sinks get the file one
+    * HIMEM_DELTA_PIECE at a time from the reader scratch block.
+    * @return bytes accepted by the sink, 0 if the baseline was overwritten
+    ----------------------------------------------------------------*/
+    uint32_t HIMEM::walkDelta(int slot, HimemChunkCallback sink, void* context) {
+        if (slot == moveSlot && !settleMove()) {
+            return 0;
+        }
+        uint8_t header[HIMEM_DELTA_HEADER];
+        uint8_t* cursor = header;
+        if (walkStored(slot, 0, HIMEM_DELTA_HEADER, copyChunk, &cursor) != HIMEM_DELTA_HEADER) {
+            return 0;
+        }
+        uint8_t baseline = header[0];
+        uint32_t stamp = header[2] | (header[3] << 8) | (header[4] << 16) | ((uint32_t)header[5] << 24);
+        if (baseline >= baselineSlots || baselineState[baseline].stamp != stamp) {
+            ESP_LOGE("readFile", "Baseline slot %d of file %d has been overwritten", baseline, idForSlot(slot));
+            return 0;
+        }
+        uint32_t bytes = record(slot).rawSize;
+        uint32_t streamBytes = record(slot).fileSize - HIMEM_DELTA_HEADER;
+        uint32_t baseAddr = baselinePage(baseline) * ESP_HIMEM_BLKSZ + sizeof(struct_HIMEM_BaselineInfo);
+        uint32_t baseBytes = (baselineState[baseline].bytes < bytes) ? baselineState[baseline].bytes : bytes;
+        HimemPatch patch = {nullptr, 0, 0, 0, baseBytes, 0, 0, 0, 0, false};
+
+        if (sink == copyChunk) {
+            uint8_t** dst = (uint8_t**)context;
+            cursor = *dst;
+            if (walkRange(baseAddr / ESP_HIMEM_BLKSZ, baseAddr % ESP_HIMEM_BLKSZ, baseBytes, copyChunk, &cursor) != baseBytes) {
+                return 0;
+            }
+            patch.out = *dst;
+            patch.end = bytes;
+            walkStored(slot, HIMEM_DELTA_HEADER, streamBytes, patchChunk, &patch);
+            if (patch.corrupt || patch.pos != bytes) {
+                return 0;
+            }
+            *dst += bytes;
+            return bytes;
+        }
+
+        if (!allocScratch(unpackBuf, 2 * HIMEM_LZ_BLOCK, "readFile")) {
+            return 0;
+        }
+        uint32_t delivered = 0;
+        for (uint32_t pos = 0; pos < bytes; pos += HIMEM_DELTA_PIECE) {
+            uint32_t pieceBytes = (bytes - pos < HIMEM_DELTA_PIECE) ? bytes - pos : HIMEM_DELTA_PIECE;
+            uint32_t prefill = (pos >= baseBytes) ? 0 : (baseBytes - pos < pieceBytes) ? baseBytes - pos : pieceBytes;
+            uint32_t addr = baseAddr + pos;
+            cursor = unpackBuf;
+            if (walkRange(addr / ESP_HIMEM_BLKSZ, addr % ESP_HIMEM_BLKSZ, prefill, copyChunk, &cursor) != prefill) {
+                return delivered;
+            }
+            patch.out = unpackBuf;
+            patch.base = pos;
+            patch.end = pos + pieceBytes;
+            walkStored(slot, HIMEM_DELTA_HEADER + patch.consumed, streamBytes - patch.consumed, patchChunk, &patch);
+            if (patch.corrupt || patch.pos != patch.end || !sink(unpackBuf, pieceBytes, context)) {
+                return delivered;
+            }
+            delivered += pieceBytes;
+        }
+        return delivered;
+    }
+
+    /* ----------------------------------------------------------- 
+    * Walk a file through the map window, handing each resident span to sink
+    * In concurrent mode the window lock is held for one bank at a time and
+    * sinks other than copyChunk get the data through the bounce buffer, so
+    * the writer is never blocked while the sink writes to an SD card.
+    * A file compactStep() is part way through moving is read from both
+    * of its pieces. A compressed file is walked through unpackChunk(),
+    * the sink gets the decompressed data one HIMEM_LZ_BLOCK at a time,
+    * and a delta file is rebuilt by walkDelta().
+    * @return bytes accepted by the sink
+    ----------------------------------------------------------------*/
+    uint32_t HIMEM::walkFile(int slot, HimemChunkCallback sink, void* context) {
+        if (record(slot).flags & HIMEM_FILE_DELTA) {
+            return walkDelta(slot, sink, context);
+        }
+        if ((record(slot).flags & HIMEM_FILE_COMPRESSED) && sink != unpackChunk) {
+            if (!allocScratch(unpackBuf, 2 * HIMEM_LZ_BLOCK, "readFile")) {
+                return 0;
+            }
+            HimemUnpack state = {sink, context, unpackBuf, unpackBuf + HIMEM_LZ_BLOCK, record(slot).rawSize, 0, 0, 0, 0, 0};
+            walkFile(slot, unpackChunk, &state);
+            return state.delivered;
+        }
+        uint32_t bytes = record(slot).fileSize;
+        if (slot != moveSlot) {
+            return walkRange(record(slot).page, record(slot).offset, bytes, sink, context);
+        }
+        uint32_t bytesRead = walkRange(moveTo / ESP_HIMEM_BLKSZ, moveTo % ESP_HIMEM_BLKSZ, moveDone, sink, context);
+        if (bytesRead < moveDone) {
+            return bytesRead;
+        }
+        uint32_t from = moveFrom + moveDone;
+        return bytesRead + walkRange(from / ESP_HIMEM_BLKSZ, from % ESP_HIMEM_BLKSZ, bytes - moveDone, sink, context);
+    }
+
+    /**
+     * walkFile() for readFile(), a file written with a checksum is checked on the way.
+     * Return 0 if it does not match, the sink has had the data by then
+     */
+    uint32_t HIMEM::walkChecked(int slot, HimemChunkCallback sink, void* context) {
+        if (!(record(slot).flags & HIMEM_FILE_CRC)) {
+            return walkFile(slot, sink, context);
+        }
+        HimemCheck check = {sink, context, 0};
+        uint32_t bytesRead = walkFile(slot, checkChunk, &check);
+        if (bytesRead == record(slot).rawSize && !checkCrc(slot, check.crc, "readFile")) {
+            return 0;
+        }
+        return bytesRead;
+    }
+
+    /**
+     * Compare a CRC taken on read with the one stored for the file, logs under tag if they differ
+     */
+    bool HIMEM::checkCrc(int slot, uint32_t crc, const char* tag) {
+        if (crc != fileCrc(slot)) {
+            ESP_LOGE(tag, "File %d checksum mismatch, stored 0x%08x, read 0x%08x",
+                idForSlot(slot), (unsigned int)fileCrc(slot), (unsigned int)crc);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Walk bytes of HIMEM from page/offset on, see walkFile()
+     */
+    uint32_t HIMEM::walkRange(uint16_t page, uint32_t offset, uint32_t bytes, HimemChunkCallback sink, void* context) {
+        uint32_t bytesToRead = bytes;
+        uint16_t currentPage = page;
+        uint32_t currentOffset = offset;
+        uint32_t bytesRead = 0;
+        bool bounce = concurrent && !directSink(sink, context);
+        unsigned int end = regionEnd(page);
+
+        while (bytesToRead > 0) {
+            lockWindow();
+            unsigned int banks = 0;
+            uint8_t* ptr = pagePtr(currentPage, &banks);
+            if (ptr == nullptr) {
+                unlockWindow();
+                ESP_LOGE("readFile", "Failed to map HIMEM page %d", currentPage);
+                return bytesRead;
+            }
+            
+            if (banks > end - currentPage) banks = end - currentPage;
+            if (concurrent) banks = 1;
+            uint32_t availableInWindow = banks * ESP_HIMEM_BLKSZ - currentOffset;
+            if (bounce && availableInWindow > HIMEM_BOUNCE_SIZE) availableInWindow = HIMEM_BOUNCE_SIZE;
+            uint32_t chunkSize = (bytesToRead <= availableInWindow) ? bytesToRead : availableInWindow;
+            
+            bool more;
+            if (bounce) {
+                memcpy(bounceBuf, ptr + currentOffset, chunkSize);
+                unlockWindow();
+                more = sink(bounceBuf, chunkSize, context);
+            } else {
+                more = sink(ptr + currentOffset, chunkSize, context);
+                unlockWindow();
+            }
+            if (!more) {
+                return bytesRead;
+            }
+            
+            bytesToRead -= chunkSize;
+            bytesRead += chunkSize;
+            
+            // Move to the page that holds the next byte of the file
+            uint32_t nextOffset = currentOffset + chunkSize;
+            currentPage += nextOffset / ESP_HIMEM_BLKSZ;
+            currentOffset = nextOffset % ESP_HIMEM_BLKSZ;
+            if (fifoMode && currentPage >= end) {
+                currentPage = 0;
+            }
+        }
+        return bytesRead;
+    }
+
+    /**
+     * Walk bytes of a file's stored data from skip on, the file must not be part way through a move
+     */
+    uint32_t HIMEM::walkStored(int slot, uint32_t skip, uint32_t bytes, HimemChunkCallback sink, void* context) {
+        uint32_t addr = (uint32_t)record(slot).page * ESP_HIMEM_BLKSZ + record(slot).offset + skip;
+        if (fifoMode && addr >= dataPages() * ESP_HIMEM_BLKSZ) {
+            addr -= dataPages() * ESP_HIMEM_BLKSZ;
+        }
+        return walkRange(addr / ESP_HIMEM_BLKSZ, addr % ESP_HIMEM_BLKSZ, bytes, sink, context);
+    }
+
+    unsigned long HIMEM::freespace(void) {
+        if (!isInitialized) {
             ESP_LOGW("freespace", "HIMEM not initialized");
             return 0;
         }
-        unsigned long avail = himemSize - ((unsigned long)cPage * ESP_HIMEM_BLKSZ) - ESP_HIMEM_BLKSZ - cOffset;
-        return avail;
+        uint32_t retired = retiredBytes;
+        unsigned long avail = (unsigned long)dataPages() * ESP_HIMEM_BLKSZ - (writtenBytes - retired);
+        return avail;
+    }
+
+    /**
+     * Pages available for file data, the baseline slots and record banks are kept out of it
+     */
+    unsigned int HIMEM::dataPages() {
+        return lastPage - baselineSlots * baselineBanks - (recordBanks - 1);
+    }
+
+    /* ----------------------------------------------------------- 
+    * Select FIFO (ring buffer) mode, clears all stored files
+    * In FIFO mode writeFile() never runs out of space: the oldest files
+    * are retired as needed and file IDs keep increasing, so use
+    * getOldestID()/getNewestID() to find the files still stored.
+    * @param enable - true for FIFO mode, false for fill-once mode
+    ----------------------------------------------------------------*/
+    void HIMEM::setFifoMode(bool enable) {
+        freeMemory();
+        fifoMode = enable;
+        concurrent = false;
+        firstID = 0;
+        nextID = 0;
+    }
+
+    /* ----------------------------------------------------------- 
+    * Select single producer / single consumer mode, clears all stored files
+    * One task writes files (writeFile, openFile/appendFile/closeFile) while
+    * another task reads them (readFile, getID, getOldestID, ...) and frees
+    * them, oldest first, with releaseFile(). Files are kept in the FIFO ring
+    * but the writer never retires files itself: when the ring is full writes
+    * return INSUFFICIENT_MEMORY or MAX_HIMEM_FILES_REACHED until the reader
+    * has released space. The oldest/newest file IDs are lock free, only the
+    * shared map window and the name index are guarded by a mutex, taken for
+    * at most one bank copy at a time. viewFile() is not available and
+    * baselines, freeMemory() and flushRecords() must not be used while both
+    * tasks are running.
+    * @param enable - true for concurrent mode, false returns to fill-once mode
+    * @return SUCCESS, INITIALIZATION_FAILED if the lock could not be created
+    ----------------------------------------------------------------*/
+    int HIMEM::setConcurrentMode(bool enable) {
+        if (!isInitialized) {
+            ESP_LOGE("setConcurrentMode", "HIMEM not initialized");
+            return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+        }
+        setFifoMode(enable);
+        if (!enable) {
+            return static_cast<int>(HimemError::SUCCESS);
+        }
+        if (windowLock == nullptr) {
+            windowLock = xSemaphoreCreateMutex();
+        }
+        if (bounceBuf == nullptr) {
+            bounceBuf = (uint8_t*)heap_caps_malloc(HIMEM_BOUNCE_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        }
+        if (windowLock == nullptr || bounceBuf == nullptr) {
+            ESP_LOGE("setConcurrentMode", "Failed to allocate the window lock");
+            return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+        }
+        concurrent = true;
+        return static_cast<int>(HimemError::SUCCESS);
+    }
+
+    /* ----------------------------------------------------------- 
+    * Free the oldest file so its space can be written again
+    * In concurrent mode this is how the reader hands space back to the
+    * writer, call it once the file has been read. Files are freed in
+    * the order they were written.
+    * @param id - file ID, must be getOldestID()
+    * @return SUCCESS, negative on error
+    ----------------------------------------------------------------*/
+    int HIMEM::releaseFile(int id) {
+        if (!isInitialized) {
+            ESP_LOGE("releaseFile", "HIMEM not initialized");
+            return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+        }
+        if (!fifoMode) {
+            ESP_LOGE("releaseFile", "Files can only be released in FIFO or concurrent mode");
+            return static_cast<int>(HimemError::INVALID_ID);
+        }
+        if (id < 0 || id != getOldestID()) {
+            ESP_LOGE("releaseFile", "File %d is not the oldest file", id);
+            return static_cast<int>(HimemError::INVALID_ID);
+        }
+        retireOldest();
+        return static_cast<int>(HimemError::SUCCESS);
+    }
+
+    /* ----------------------------------------------------------- 
+    * Delete a file and free its space
+    * In fill-once mode the space becomes a hole that writeFile() reuses
+    * (best fit) and that compactStep() closes by sliding the files above
+    * it down. In FIFO mode the space is reused once the ring gets to it.
+    * In concurrent mode the reader frees files with releaseFile() instead.
+    * Once the oldest files are deleted their record slots are reused, so
+    * a store that keeps deleting its oldest files can be written to for
+    * ever; a file kept from the start holds MAX_HIMEM_FILES IDs after it.
+    * @param id - file ID
+    * @return SUCCESS, negative on error
+    ----------------------------------------------------------------*/
+    int HIMEM::deleteFile(int id) {
+        if (!isInitialized) {
+            ESP_LOGE("deleteFile", "HIMEM not initialized");
+            return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+        }
+        if (concurrent) {
+            ESP_LOGE("deleteFile", "Files are freed with releaseFile() in concurrent mode");
+            return static_cast<int>(HimemError::INVALID_ID);
+        }
+        int slot = findSlot(id, "deleteFile");
+        if (slot < 0) {
+            return static_cast<int>(HimemError::INVALID_ID);
+        }
+        if (!fifoMode) {
+            if (!settleMove()) {
+                return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+            }
+            if (extentCount == HIMEM_FREE_EXTENTS) {
+                compactAll();                       // no room to track another hole
+            }
+            if (extentCount == HIMEM_FREE_EXTENTS) {
+                ESP_LOGE("deleteFile", "Too many holes and HIMEM could not be compacted");
+                return static_cast<int>(HimemError::INSUFFICIENT_MEMORY);
+            }
+        }
+        bool indexed = indexRemove(slot);
+        record(slot).flags |= HIMEM_FILE_DELETED;
+        markRecordDirty(slot);
+        if (indexed) {
+            reindexName(fileName(slot));            // a file with the same name was shadowed by this one
+        }
+        deletedFiles++;
+        if (fifoMode) {
+            if ((uint32_t)id == firstID) {
+                retireOldest();
+            }
+        } else {
+            freeExtent((uint32_t)record(slot).page * ESP_HIMEM_BLKSZ + record(slot).offset, record(slot).fileSize);
+            retiredBytes += record(slot).fileSize;
+            // Deleted files at the front give up their IDs, so their record slots and blocks can be reused
+            while (firstID < nextID && (record(firstID % HIMEM_RECORD_SLOTS).flags & HIMEM_FILE_DELETED)) {
+                deletedFiles--;
+                firstID = firstID + 1;
+            }
+        }
+        return static_cast<int>(HimemError::SUCCESS);
+    }
+
+    /* ----------------------------------------------------------- 
+    * Incremental compaction, call from loop() or an idle task
+    * Once the holes left by deleteFile() reach the compaction threshold
+    * (setCompactThreshold()) each call moves up to one bank of the file
+    * above the lowest hole down into it, so the holes bubble up into the
+    * free space at the end. Files stay readable while they are moved.
+    * Nothing is moved while a HimemView is held or a file is open past
+    * the hole.
+    * @return bytes moved, 0 if there is nothing to do
+    ----------------------------------------------------------------*/
+    uint32_t HIMEM::compactStep() {
+        if (!isInitialized || fifoMode || viewPins > 0) {
+            return 0;
+        }
+        if (moveSlot < 0 && (extentCount == 0 || getFragmentation() < compactThreshold)) {
+            return 0;
+        }
+        return moveStep();
+    }
+
+    /**
+     * Free space in holes, as a percentage of all free space
+     */
+    uint8_t HIMEM::getFragmentation() {
+        unsigned long free = freespace();
+        if (extentCount == 0 || free == 0) {
+            return 0;
+        }
+        uint64_t holes = 0;
+        for (uint16_t i = 0; i < extentCount; i++) {
+            holes += freeExtents[i].bytes;
+        }
+        return (uint8_t)(holes * 100 / free);
+    }
+
+    /**
+     * Fragmentation in percent at which compactStep() starts moving files, 0 = on any hole
+     */
+    void HIMEM::setCompactThreshold(uint8_t percent) {
+        compactThreshold = percent;
+    }
+
+    /**
+     * Address of the write position, everything from here to the end of the data pages is free
+     */
+    uint32_t HIMEM::cursorAddr() {
+        return (uint32_t)cPage * ESP_HIMEM_BLKSZ + cOffset;
+    }
+
+    uint32_t HIMEM::wilderness() {
+        return (uint32_t)dataPages() * ESP_HIMEM_BLKSZ - cursorAddr();
+    }
+
+    /**
+     * Best fit: take bytes from the smallest hole they fit in
+     * @return false if no hole is large enough
+     */
+    bool HIMEM::takeExtent(uint32_t bytes, uint32_t& addr) {
+        int best = -1;
+        for (uint16_t i = 0; i < extentCount; i++) {
+            if (freeExtents[i].bytes >= bytes && (best < 0 || freeExtents[i].bytes < freeExtents[best].bytes)) {
+                best = i;
+            }
+        }
+        if (best < 0) {
+            return false;
+        }
+        addr = freeExtents[best].start;
+        freeExtents[best].start += bytes;
+        freeExtents[best].bytes -= bytes;
+        if (freeExtents[best].bytes == 0) {
+            removeExtent(best);
+        }
+        return true;
+    }
+
+    /**
+     * Add a hole, merged with its neighbours. The caller makes sure the list has room
+     */
+    void HIMEM::freeExtent(uint32_t start, uint32_t bytes) {
+        uint16_t i = 0;
+        while (i < extentCount && freeExtents[i].start < start) {
+            i++;
+        }
+        bool joinPrev = i > 0 && freeExtents[i - 1].start + freeExtents[i - 1].bytes == start;
+        bool joinNext = i < extentCount && start + bytes == freeExtents[i].start;
+        if (joinPrev && joinNext) {
+            freeExtents[i - 1].bytes += bytes + freeExtents[i].bytes;
+            removeExtent(i);
+        } else if (joinPrev) {
+            freeExtents[i - 1].bytes += bytes;
+        } else if (joinNext) {
+            freeExtents[i].start = start;
+            freeExtents[i].bytes += bytes;
+        } else {
+            memmove(&freeExtents[i + 1], &freeExtents[i], (extentCount - i) * sizeof(FreeExtent));
+            freeExtents[i].start = start;
+            freeExtents[i].bytes = bytes;
+            extentCount++;
+        }
+        absorbWilderness();
+    }
+
+    void HIMEM::removeExtent(uint16_t i) {
+        extentCount--;
+        memmove(&freeExtents[i], &freeExtents[i + 1], (extentCount - i) * sizeof(FreeExtent));
+    }
+
+    /**
+     * A hole that ends at the write position moves the write position back instead
+     */
+    void HIMEM::absorbWilderness() {
+        if (openID >= 0 || extentCount == 0) {
+            return;                                 // the open file starts at the write position
+        }
+        FreeExtent& last = freeExtents[extentCount - 1];
+        if (last.start + last.bytes == cursorAddr()) {
+            cPage = last.start / ESP_HIMEM_BLKSZ;
+            cOffset = last.start % ESP_HIMEM_BLKSZ;
+            extentCount--;
+        }
+    }
+
+    /**
+     * Record slot of the stored file starting at addr, -1 if there is none
+     */
+    int HIMEM::fileAt(uint32_t addr) {
+        for (uint32_t id = firstID; id < nextID; id++) {
+            int slot = id % HIMEM_RECORD_SLOTS;
+            if (!(record(slot).flags & HIMEM_FILE_DELETED) &&
+                (uint32_t)record(slot).page * ESP_HIMEM_BLKSZ + record(slot).offset == addr) {
+                return slot;
+            }
+        }
+        return -1;
+    }
+
+    /* ----------------------------------------------------------- 
+    * Move up to one bank of the file above the lowest hole into it,
+    * starting a new move if none is in progress. When the file is
+    * complete the hole, now above it, is merged with the next one.
+    * @return bytes moved, 0 if nothing could be moved
+    ----------------------------------------------------------------*/
+    uint32_t HIMEM::moveStep() {
+        if (moveSlot < 0) {
+            if (extentCount == 0) {
+                return 0;
+            }
+            uint32_t from = freeExtents[0].start + freeExtents[0].bytes;
+            int slot = fileAt(from);
+            if (slot < 0) {
+                return 0;                           // the open file follows the hole
+            }
+            moveSlot = slot;
+            moveFrom = from;
+            moveTo = freeExtents[0].start;
+            moveDone = 0;
+        }
+        uint32_t size = record(moveSlot).fileSize;
+        uint32_t bytes = size - moveDone;
+        if (bytes > ESP_HIMEM_BLKSZ) bytes = ESP_HIMEM_BLKSZ;
+        uint32_t moved = 0;
+        while (moved < bytes) {
+            uint32_t piece = copyBytes(moveTo + moveDone, moveFrom + moveDone, bytes - moved);
+            if (piece == 0) {
+                return moved;
+            }
+            moveDone += piece;                      // reads see each piece at its new place right away
+            moved += piece;
+        }
+        if (moveDone == size) {
+            record(moveSlot).page = moveTo / ESP_HIMEM_BLKSZ;
+            record(moveSlot).offset = moveTo % ESP_HIMEM_BLKSZ;
+            markRecordDirty(moveSlot);
+            moveSlot = -1;
+            uint32_t gap = moveFrom - moveTo;
+            removeExtent(0);
+            freeExtent(moveTo + size, gap);
+        }
+        return moved;
+    }
+
+    /* ----------------------------------------------------------- 
+    * Copy bytes from one HIMEM address to another, bank to bank
+    * Directly when both fit in the map window, or when the map range has
+    * room for both, with the destination and source banks mapped side by
+    * side. Otherwise up to HIMEM_BOUNCE_SIZE bytes go through the bounce
+    * buffer.
+    * @return bytes copied, 0 on error
+    ----------------------------------------------------------------*/
+    uint32_t HIMEM::copyBytes(uint32_t to, uint32_t from, uint32_t bytes) {
+        uint32_t low = (to < from) ? to : from;
+        uint32_t high = (to < from) ? from : to;
+        unsigned int page = low / ESP_HIMEM_BLKSZ;
+        unsigned int pages = (high + bytes - 1) / ESP_HIMEM_BLKSZ - page + 1;
+        if (pages <= rangeBanks) {
+            lockWindow();
+            uint8_t* ptr = pagePtr(page, nullptr, pages);
+            if (ptr != nullptr) {
+                memmove(ptr + (to - page * ESP_HIMEM_BLKSZ), ptr + (from - page * ESP_HIMEM_BLKSZ), bytes);
+            }
+            unlockWindow();
+            return (ptr != nullptr) ? bytes : 0;
+        }
+        unsigned int toPage = to / ESP_HIMEM_BLKSZ;
+        unsigned int toPages = (to + bytes - 1) / ESP_HIMEM_BLKSZ - toPage + 1;
+        unsigned int fromPage = from / ESP_HIMEM_BLKSZ;
+        unsigned int fromPages = (from + bytes - 1) / ESP_HIMEM_BLKSZ - fromPage + 1;
+        if (toPages + fromPages <= rangeBanks && viewPins == 0) {
+            lockWindow();
+            bool copied = copySplit(toPage, toPages, fromPage, fromPages, to % ESP_HIMEM_BLKSZ, from % ESP_HIMEM_BLKSZ, bytes);
+            unlockWindow();
+            return copied ? bytes : 0;
+        }
+        if (bounceBuf == nullptr) {
+            bounceBuf = (uint8_t*)heap_caps_malloc(HIMEM_BOUNCE_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+            if (bounceBuf == nullptr) {
+                ESP_LOGE("copyBytes", "Failed to allocate the bounce buffer");
+                return 0;
+            }
+        }
+        if (bytes > HIMEM_BOUNCE_SIZE) bytes = HIMEM_BOUNCE_SIZE;
+        uint8_t* cursor = bounceBuf;
+        if (walkRange(fromPage, from % ESP_HIMEM_BLKSZ, bytes, copyChunk, &cursor) != bytes) {
+            return 0;
+        }
+        uint16_t bouncePage = toPage;
+        uint16_t bounceOffset = to % ESP_HIMEM_BLKSZ;
+        return copyIn(bouncePage, bounceOffset, bounceBuf, bytes) ? bytes : 0;
+    }
+
+    /**
+     * Map the destination banks at the start of the map range and the source banks
+     * right after them, copy, and unmap both. The banks must not overlap
+     */
+    bool HIMEM::copySplit(unsigned int toPage, unsigned int toPages, unsigned int fromPage, unsigned int fromPages,
+                          uint32_t toOffset, uint32_t fromOffset, uint32_t bytes) {
+        uint8_t* dst = nullptr;
+        uint8_t* src = nullptr;
+        if (!mapSplit(toPage, toPages, fromPage, fromPages, dst, src)) {
+            return false;
+        }
+        memcpy(dst + toOffset, src + fromOffset, bytes);
+        unmapSplit(dst, toPages, src, fromPages);
+        return true;
+    }
+
+    /**
+     * Map two runs of banks side by side in the map range, in place of the resident window
+     */
+    bool HIMEM::mapSplit(unsigned int firstPage, unsigned int firstPages, unsigned int secondPage, unsigned int secondPages,
+                         uint8_t*& first, uint8_t*& second) {
+        if (releaseWindow() != ESP_OK) {
+            return false;
+        }
+        unsigned long start = micros();
+        mapStats.maps++;
+        esp_err_t ret = esp_himem_map(memptr, rangeptr, (size_t)(pageBase + firstPage) * ESP_HIMEM_BLKSZ, 0,
+            (size_t)firstPages * ESP_HIMEM_BLKSZ, 0, (void**)&first);
+        if (ret == ESP_OK) {
+            mapStats.maps++;
+            ret = esp_himem_map(memptr, rangeptr, (size_t)(pageBase + secondPage) * ESP_HIMEM_BLKSZ, (size_t)firstPages * ESP_HIMEM_BLKSZ,
+                (size_t)secondPages * ESP_HIMEM_BLKSZ, 0, (void**)&second);
+            if (ret != ESP_OK) {
+                mapStats.unmaps++;
+                esp_himem_unmap(rangeptr, first, (size_t)firstPages * ESP_HIMEM_BLKSZ);
+            }
+        }
+        mapStats.mapMicros += micros() - start;
+        if (ret != ESP_OK) {
+            ESP_LOGE("mapSplit", "Failed to map HIMEM pages %d and %d: %s", firstPage, secondPage, esp_err_to_name(ret));
+            return false;
+        }
+        return true;
+    }
+
+    void HIMEM::unmapSplit(uint8_t* first, unsigned int firstPages, uint8_t* second, unsigned int secondPages) {
+        unsigned long start = micros();
+        mapStats.unmaps += 2;
+        esp_himem_unmap(rangeptr, second, (size_t)secondPages * ESP_HIMEM_BLKSZ);
+        esp_himem_unmap(rangeptr, first, (size_t)firstPages * ESP_HIMEM_BLKSZ);
+        mapStats.mapMicros += micros() - start;
+    }
+
+    /**
+     * Finish the move in progress, the free list is only up to date without one
+     * @return false if the move could not be finished
+     */
+    bool HIMEM::settleMove() {
+        while (moveSlot >= 0 && moveStep() > 0) {}
+        if (moveSlot >= 0) {
+            ESP_LOGE("compactStep", "Could not finish moving file %d", idForSlot(moveSlot));
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Close every hole that can be closed
+     */
+    void HIMEM::compactAll() {
+        while (moveStep() > 0) {}
+    }
+
+    int HIMEM::getOldestID() {
+        uint32_t last = nextID;
+        for (uint32_t id = firstID; id < last; id++) {
+            if (!(record(id % HIMEM_RECORD_SLOTS).flags & HIMEM_FILE_DELETED)) {
+                return (int)id;
+            }
+        }
+        return -1;
+    }
+
+    int HIMEM::getNewestID() {
+        uint32_t first = firstID;
+        for (uint32_t id = nextID; id-- > first; ) {
+            if (!(record(id % HIMEM_RECORD_SLOTS).flags & HIMEM_FILE_DELETED)) {
+                return (int)id;
+            }
+        }
+        return -1;
+    }
+
+    uint16_t HIMEM::getFileCount() {
+        return slotsUsed() - deletedFiles;
+    }
+
+    /**
+     * File IDs in use, including deleted files not yet retired
+     */
+    uint32_t HIMEM::slotsUsed() {
+        uint32_t first = firstID;
+        return nextID - first;
+    }
+
+    /**
+     * Drop the oldest file from the FIFO, its space is reused by the next write.
+     * Deleted files right behind it are dropped as well
+     */
+    void HIMEM::retireOldest() {
+        do {
+            uint32_t id = firstID;
+            uint16_t slot = id % HIMEM_RECORD_SLOTS;
+            if (record(slot).flags & HIMEM_FILE_DELETED) {
+                deletedFiles--;                     // left the name index in deleteFile()
+            } else {
+                lockWindow();
+                indexRemove(slot);
+                unlockWindow();
+            }
+            retiredBytes += record(slot).fileSize;
+            firstID = id + 1;
+        } while (firstID < nextID && (record(firstID % HIMEM_RECORD_SLOTS).flags & HIMEM_FILE_DELETED));
+    }
+
+    /**
+     * Record slot holding file id, -1 if the id is not stored or was deleted
+     */
+    int HIMEM::slotForID(int id) {
+        uint32_t first = firstID;
+        if (id < 0 || (uint32_t)id < first || (uint32_t)id >= nextID) {
+            return -1;
+        }
+        int slot = id % HIMEM_RECORD_SLOTS;
+        return (record(slot).flags & HIMEM_FILE_DELETED) ? -1 : slot;
+    }
+
+    /**
+     * File id stored in a record slot
+     */
+    int HIMEM::idForSlot(int slot) {
+        int first = firstID % HIMEM_RECORD_SLOTS;
+        return firstID + ((slot - first + HIMEM_RECORD_SLOTS) % HIMEM_RECORD_SLOTS);
+    }
+
+    /**
+     * Record of a slot, its block must have been allocated by reserveRecords()
+     */
+    struct_HIMEM_FileInfo& HIMEM::record(uint16_t slot) {
+        return recordBlocks[slot / HIMEM_RECORD_BLOCK]->records[slot % HIMEM_RECORD_BLOCK];
+    }
+
+    /**
+     * Name of the file in a slot, "" if it has none
+     */
+    const char* HIMEM::fileName(uint16_t slot) {
+        RecordBlock* block = recordBlocks[slot / HIMEM_RECORD_BLOCK];
+        uint16_t name = block->records[slot % HIMEM_RECORD_BLOCK].name;
+        if (name == 0) {
+            return "";
+        }
+        return block->names[(name - 1) / HIMEM_NAME_CHUNK] + (name - 1) % HIMEM_NAME_CHUNK;
+    }
+
+    /**
+     * Give the file in a slot its write time and the current setTag() value
+     */
+    void HIMEM::stampFile(uint16_t slot) {
+        RecordBlock* block = recordBlocks[slot / HIMEM_RECORD_BLOCK];
+        block->times[slot % HIMEM_RECORD_BLOCK] = millis();
+        block->tags[slot % HIMEM_RECORD_BLOCK] = writeTag;
+    }
+
+    /**
+     * millis() when the file in a slot was written
+     */
+    uint32_t HIMEM::fileTime(uint16_t slot) {
+        return recordBlocks[slot / HIMEM_RECORD_BLOCK]->times[slot % HIMEM_RECORD_BLOCK];
+    }
+
+    /**
+     * CRC-32 of the file in a slot, valid if it has HIMEM_FILE_CRC
+     */
+    uint32_t& HIMEM::fileCrc(uint16_t slot) {
+        return recordBlocks[slot / HIMEM_RECORD_BLOCK]->crcs[slot % HIMEM_RECORD_BLOCK];
+    }
+
+    /* ----------------------------------------------------------- 
+    * Store the name of the file in a slot with its index block
+    * Names are packed into the block's name chunks, an empty name takes
+    * no space and a name repeated from the previous file is shared.
+    * @param length - name length without the terminator
+    * @return false if no name chunk could be allocated
+    ----------------------------------------------------------------*/
+    bool HIMEM::storeName(uint16_t slot, const char* name, uint8_t length) {
+        RecordBlock* block = recordBlocks[slot / HIMEM_RECORD_BLOCK];
+        struct_HIMEM_FileInfo& info = block->records[slot % HIMEM_RECORD_BLOCK];
+        info.name = 0;
+        info.nameLength = length;
+        if (length == 0) {
+            return true;
+        }
+        if (block->lastName != 0 && strcmp(block->names[(block->lastName - 1) / HIMEM_NAME_CHUNK] +
+                                           (block->lastName - 1) % HIMEM_NAME_CHUNK, name) == 0) {
+            info.name = block->lastName;
+            return true;
+        }
+        uint32_t at = block->nameEnd;
+        if (at % HIMEM_NAME_CHUNK + length + 1 > HIMEM_NAME_CHUNK) {
+            at = (at / HIMEM_NAME_CHUNK + 1) * HIMEM_NAME_CHUNK;     // names do not cross chunks
+        }
+        uint32_t chunk = at / HIMEM_NAME_CHUNK;
+        if (chunk >= HIMEM_NAME_CHUNKS) {
+            ESP_LOGE("writeFile", "No room for more file names in record block %d", slot / HIMEM_RECORD_BLOCK);
+            return false;
+        }
+        if (block->names[chunk] == nullptr) {
+            block->names[chunk] = (char*)heap_caps_malloc(HIMEM_NAME_CHUNK, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+            if (block->names[chunk] == nullptr) {
+                block->names[chunk] = (char*)heap_caps_malloc(HIMEM_NAME_CHUNK, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+            }
+            if (block->names[chunk] == nullptr) {
+                ESP_LOGE("writeFile", "Failed to allocate file names");
+                return false;
+            }
+        }
+        memcpy(block->names[chunk] + at % HIMEM_NAME_CHUNK, name, length);
+        block->names[chunk][at % HIMEM_NAME_CHUNK + length] = 0;
+        block->nameEnd = at + length + 1;
+        block->lastName = at + 1;
+        info.name = block->lastName;
+        return true;
+    }
+
+    /* ----------------------------------------------------------- 
+    * Make sure the record blocks for the next newRecords file IDs exist
+    * Blocks of retired files are freed first, so a FIFO only keeps the
+    * blocks of the files it holds. A new block gets a home in the record
+    * banks, taking another bank from the top of the data pages if all
+    * homes are in use.
+    * @return false if MAX_HIMEM_FILES would be passed or no block could be added
+    ----------------------------------------------------------------*/
+    bool HIMEM::reserveRecords(uint16_t newRecords) {
+        if (newRecords == 0) {
+            return true;
+        }
+        if (slotsUsed() + newRecords > MAX_HIMEM_FILES) {
+            return false;
+        }
+        uint32_t last = nextID + newRecords - 1;
+        for (uint32_t base = nextID - nextID % HIMEM_RECORD_BLOCK; base <= last; base += HIMEM_RECORD_BLOCK) {
+            RecordBlock* block = recordBlocks[(base / HIMEM_RECORD_BLOCK) % HIMEM_RECORD_BLOCKS];
+            if (block == nullptr || block->base != base) {
+                if (!addRecordBlock(base)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Allocate the record block for file IDs base on and give it a home in the record banks
+     */
+    bool HIMEM::addRecordBlock(uint32_t base) {
+        freeRecordBlocks(false);
+        bool homeUsed[HIMEM_RECORD_BLOCKS] = {};
+        for (uint16_t b = 0; b < HIMEM_RECORD_BLOCKS; b++) {
+            if (recordBlocks[b] != nullptr) {
+                homeUsed[recordBlocks[b]->home] = true;
+            }
+        }
+        uint16_t home = 0;
+        while (home < recordBanks * HIMEM_BLOCKS_PER_BANK && homeUsed[home]) {
+            home++;
+        }
+        if (home == recordBanks * HIMEM_BLOCKS_PER_BANK && !growRecordBanks()) {
+            return false;
+        }
+        RecordBlock* block = (RecordBlock*)heap_caps_calloc(1, sizeof(RecordBlock), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (block == nullptr) {
+            block = (RecordBlock*)heap_caps_calloc(1, sizeof(RecordBlock), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        }
+        if (block == nullptr) {
+            ESP_LOGE("writeFile", "Failed to allocate file records");
+            return false;
+        }
+        block->base = base;
+        block->home = home;
+        recordBlocks[(base / HIMEM_RECORD_BLOCK) % HIMEM_RECORD_BLOCKS] = block;
+        return true;
+    }
+
+    /**
+     * Free the record blocks whose files have all been retired, or all of them.
+     * Only the writer frees blocks, the reader never touches records below firstID
+     */
+    void HIMEM::freeRecordBlocks(bool all) {
+        uint32_t first = firstID;
+        for (uint16_t b = 0; b < HIMEM_RECORD_BLOCKS; b++) {
+            RecordBlock* block = recordBlocks[b];
+            if (block != nullptr && (all || block->base + HIMEM_RECORD_BLOCK <= first)) {
+                for (uint8_t i = 0; i < HIMEM_NAME_CHUNKS; i++) {
+                    if (block->names[i] != nullptr) {
+                        heap_caps_free(block->names[i]);
+                    }
+                }
+                heap_caps_free(block);
+                recordBlocks[b] = nullptr;
+            }
+        }
+    }
+
+    /**
+     * Take the top data bank for HIMEM_BLOCKS_PER_BANK more record block homes.
+     * Only possible while no file data is in it, so FIFO mode has to be before its first wrap
+     */
+    bool HIMEM::growRecordBanks() {
+        if (recordBanks * HIMEM_BLOCKS_PER_BANK >= HIMEM_RECORD_BLOCKS || dataPages() < 2) {
+            return false;
+        }
+        uint32_t top = (uint32_t)(dataPages() - 1) * ESP_HIMEM_BLKSZ;
+        if (cursorAddr() > top) {
+            return false;
+        }
+        if (fifoMode && slotsUsed() > 0) {
+            struct_HIMEM_FileInfo& oldest = record(firstID % HIMEM_RECORD_SLOTS);
+            if ((uint32_t)oldest.page * ESP_HIMEM_BLKSZ + oldest.offset >= cursorAddr()) {
+                return false;                       // the ring has wrapped, files end in the top bank
+            }
+        }
+        recordBanks++;
+        return true;
+    }
+
+    /**
+     * Page of a record block home: lastPage, then the banks taken below the baseline slots
+     */
+    unsigned int HIMEM::recordPage(uint8_t home) {
+        unsigned int bank = home / HIMEM_BLOCKS_PER_BANK;
+        return (bank == 0) ? lastPage : lastPage - baselineSlots * baselineBanks - bank;
+    }
+
+    /**
+     * Reset file system without deallocating HIMEM
+     */
+    void HIMEM::freeMemory(void) {
+        if (!isInitialized) {
+            ESP_LOGW("freeMemory", "HIMEM not initialized");
+            return;
+        }
+
+        //ESP_LOGI("freeMemory", "File system reset complete, freed %d files", getFileCount());   
+        firstID = fifoMode ? (uint32_t)nextID : 0;         // FIFO ids never repeat
+        nextID = (uint32_t)firstID;
+        writtenBytes = 0;
+        retiredBytes = 0;
+        openID = -1;
+        cPage = 0;
+        cOffset = 0;
+        deletedFiles = 0;
+        extentCount = 0;
+        moveSlot = -1;
+        dirtyFirst = 0;
+        dirtyCount = 0;
+        freeRecordBlocks(true);
+        recordBanks = 1;                                   // extra record banks go back to the data pages
+        memset(nameIndex, 0, nameIndexSize * sizeof(uint16_t));
+        namedFiles = 0;
+    }
+
+    uint32_t HIMEM::getFilesize(int id) {
+        if (!isInitialized) {
+            ESP_LOGW("getFilesize", "HIMEM not initialized");
+            return 0;
+        }
+        struct_HIMEM_FileInfo info = getRecord(id);
+        return info.rawSize;
+    }
+
+    uint32_t HIMEM::getStoredSize(int id) {
+        if (!isInitialized) {
+            ESP_LOGW("getStoredSize", "HIMEM not initialized");
+            return 0;
+        }
+        struct_HIMEM_FileInfo info = getRecord(id);
+        return info.fileSize;
+    }
+    
+    String HIMEM::getFileName(int id) {
+        if (!isInitialized) {
+            ESP_LOGW("getFileName", "HIMEM not initialized");
+            return String("");
+        }
+        int slot = slotForID(id);
+        return (slot < 0) ? String("") : String(fileName(slot));
+    }
+
+    uint32_t HIMEM::getTimestamp(int id) {
+        if (!isInitialized) {
+            ESP_LOGW("getTimestamp", "HIMEM not initialized");
+            return 0;
+        }
+        int slot = slotForID(id);
+        return (slot < 0) ? 0 : fileTime(slot);
+    }
+
+    uint16_t HIMEM::getTag(int id) {
+        if (!isInitialized) {
+            ESP_LOGW("getTag", "HIMEM not initialized");
+            return 0;
+        }
+        int slot = slotForID(id);
+        return (slot < 0) ? 0 : recordBlocks[slot / HIMEM_RECORD_BLOCK]->tags[slot % HIMEM_RECORD_BLOCK];
+    }
+
+    /* ----------------------------------------------------------- 
+    * Get the IDs of the files written in a time range
+    * Files get IDs in the order they are written, so their write times
+    * are sorted by ID and the first file of the range is found with a
+    * binary search; only the files in the range are visited after that.
+    * Times are compared relative to the oldest stored file, so millis()
+    * wrapping is handled as long as from and to are within 24 days of
+    * the stored files.
+    * @param from - first millis() of the range, e.g. trigger - 3000
+    * @param to - last millis() of the range, inclusive
+    * @param ids - receives the file IDs, oldest first
+    * @param maxIds - size of ids, the search stops when it is full
+    * @param tag - only files written with this setTag() value, -1 = any
+    * @return number of IDs stored in ids, negative on error
+    ----------------------------------------------------------------*/
+    int HIMEM::getIDs(uint32_t from, uint32_t to, int* ids, uint16_t maxIds, int tag) {
+        if (!isInitialized) {
+            ESP_LOGW("getIDs", "HIMEM not initialized");
+            return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+        }
+        if (ids == nullptr && maxIds > 0) {
+            ESP_LOGE("getIDs", "No buffer for the IDs");
+            return static_cast<int>(HimemError::INVALID_ID);
+        }
+        uint32_t first = firstID;
+        uint32_t last = nextID;
+        if (first == last) {
+            return 0;
+        }
+        uint32_t ref = fileTime(first % HIMEM_RECORD_SLOTS);
+        int32_t start = (int32_t)(from - ref);
+        int32_t end = (int32_t)(to - ref);
+    /* Oldest file written at or after from */
+        uint32_t low = first;
+        uint32_t high = last;
+        while (low < high) {
+            uint32_t mid = low + (high - low) / 2;
+            if ((int32_t)(fileTime(mid % HIMEM_RECORD_SLOTS) - ref) < start) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        int found = 0;
+        for (uint32_t id = low; id < last && found < maxIds; id++) {
+            uint16_t slot = id % HIMEM_RECORD_SLOTS;
+            if ((int32_t)(fileTime(slot) - ref) > end) {
+                break;
+            }
+            if (record(slot).flags & HIMEM_FILE_DELETED) {
+                continue;
+            }
+            if (tag >= 0 && recordBlocks[slot / HIMEM_RECORD_BLOCK]->tags[slot % HIMEM_RECORD_BLOCK] != tag) {
+                continue;
+            }
+            ids[found++] = (int)id;
+        }
+        return found;
+    }
+
+    int HIMEM::getID(String filename) {
+        return getID(filename.c_str());
+    }
+
+    /* ----------------------------------------------------------- 
+    * Get file ID by name using the filename hash index
+    * @param filename - null terminated file name
+    * @return file ID of the first file written with this name, -1 if not found
+    ----------------------------------------------------------------*/
+    int HIMEM::getID(const char* filename) {
+        if (!isInitialized) {
+            ESP_LOGW("getID", "HIMEM not initialized");
+            return 0;
+        }
+        unsigned long start = micros();
+        lockWindow();
+        int slot = indexFind(filename);
+        int id = (slot == -1) ? -1 : idForSlot(slot);
+        addLatency(opStats.lookupLatency, micros() - start);   // under the lock, getID() may be called by both tasks
+        unlockWindow();
+        if (id == -1) {
+            ESP_LOGW("getID", "File %s not found", filename);
+        }
+        return id;
     }
 
     /**
-     * Reset file system without deallocating HIMEM
+     * FNV-1a hash of a file name
      */
-    void HIMEM::freeMemory(void) {
-        if (!isInitialized) {
-            ESP_LOGW("freeMemory", "HIMEM not initialized");
+    uint32_t HIMEM::nameHash(const char* name) {
+        uint32_t hash = 2166136261u;
+        while (*name) {
+            hash ^= (uint8_t)*name++;
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    /**
+     * Add a record slot to the name index. An existing file with the same name
+     * keeps precedence, except in FIFO mode where the newest file wins.
+     * Files without a name are not indexed
+     */
+    void HIMEM::indexInsert(uint16_t slot) {
+        const char* name = fileName(slot);
+        if (*name == 0) {
+            return;
+        }
+        if ((namedFiles + 1) * 2 > nameIndexSize && !growNameIndex() && namedFiles + 1 >= nameIndexSize) {
+            ESP_LOGW("writeFile", "Filename index is full, %s cannot be found by name", name);
             return;
         }
+        const uint32_t mask = nameIndexSize - 1;
+        uint32_t i = nameHash(name) & mask;
+        while (nameIndex[i] != 0) {
+            if (strcmp(fileName(nameIndex[i] - 1), name) == 0) {
+                if (fifoMode) nameIndex[i] = slot + 1;
+                return;
+            }
+            i = (i + 1) & mask;
+        }
+        nameIndex[i] = slot + 1;
+        namedFiles++;
+    }
 
-        //ESP_LOGI("freeMemory", "File system reset complete, freed %d files", fileIndex);   
-        fileIndex = 0;
-        cPage = 0;
-        cOffset = 0;
-        records = nullptr;
+    /**
+     * Double the name index and rehash it, keeps probe chains short as files are added
+     * @return false if the larger index could not be allocated
+     */
+    bool HIMEM::growNameIndex() {
+        uint32_t size = nameIndexSize * 2;
+        if (size > 2 * HIMEM_RECORD_SLOTS) {
+            return false;
+        }
+        uint16_t* grown = (uint16_t*)heap_caps_calloc(size, sizeof(uint16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (grown == nullptr) {
+            grown = (uint16_t*)heap_caps_calloc(size, sizeof(uint16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        }
+        if (grown == nullptr) {
+            return false;
+        }
+        for (uint32_t j = 0; j < nameIndexSize; j++) {
+            if (nameIndex[j] != 0) {
+                uint32_t i = nameHash(fileName(nameIndex[j] - 1)) & (size - 1);
+                while (grown[i] != 0) {
+                    i = (i + 1) & (size - 1);
+                }
+                grown[i] = nameIndex[j];
+            }
+        }
+        heap_caps_free(nameIndex);
+        nameIndex = grown;
+        nameIndexSize = size;
+        return true;
     }
 
-    uint32_t HIMEM::getFilesize(int id) {
-        if (!isInitialized) {
-            ESP_LOGW("getFilesize", "HIMEM not initialized");
-            return 0;
+    /**
+     * Remove a record slot from the name index, backward shift keeps probe chains intact
+     * @return false if the slot was not in the index
+     */
+    bool HIMEM::indexRemove(uint16_t slot) {
+        const char* name = fileName(slot);
+        if (*name == 0) {
+            return false;
         }
-        struct_HIMEM_FileInfo info = getRecord(id);
-        return info.fileSize;
+        const uint32_t mask = nameIndexSize - 1;
+        uint32_t i = nameHash(name) & mask;
+        while (nameIndex[i] != slot + 1) {
+            if (nameIndex[i] == 0) {
+                return false;                       // shadowed by another file with the same name
+            }
+            i = (i + 1) & mask;
+        }
+        uint32_t j = i;
+        while (true) {
+            j = (j + 1) & mask;
+            if (nameIndex[j] == 0) {
+                break;
+            }
+            uint32_t home = nameHash(fileName(nameIndex[j] - 1)) & mask;
+            // Move the entry into the hole unless its home bucket lies cyclically in (i, j]
+            bool stays = (i < j) ? (home > i && home <= j) : (home > i || home <= j);
+            if (!stays) {
+                nameIndex[i] = nameIndex[j];
+                i = j;
+            }
+        }
+        nameIndex[i] = 0;
+        namedFiles--;
+        return true;
     }
-    
-    String HIMEM::getFileName(int id) {
-        if (!isInitialized) {
-            ESP_LOGW("getFileName", "HIMEM not initialized");
-            return String("");
+
+    /**
+     * Index the file that takes precedence for a name once its indexed file is deleted:
+     * the oldest live file with the name, the newest in FIFO mode
+     */
+    void HIMEM::reindexName(const char* name) {
+        uint32_t count = nextID - firstID;
+        for (uint32_t n = 0; n < count; n++) {
+            uint32_t id = fifoMode ? nextID - 1 - n : firstID + n;
+            uint16_t slot = id % HIMEM_RECORD_SLOTS;
+            if (!(record(slot).flags & HIMEM_FILE_DELETED) && strcmp(fileName(slot), name) == 0) {
+                indexInsert(slot);
+                return;
+            }
         }
-        struct_HIMEM_FileInfo info = getRecord(id);
-        return String(info.filename);
     }
 
-    int HIMEM::getID(String filename) {
-        if (!isInitialized) {
-            ESP_LOGW("getID", "HIMEM not initialized");
-            return 0;
+    /**
+     * Find the record slot for a name, linear probing from the hash bucket
+     */
+    int HIMEM::indexFind(const char* name) {
+        if (*name == 0) {
+            return -1;
+        }
+        const uint32_t mask = nameIndexSize - 1;
+        uint32_t i = nameHash(name) & mask;
+        while (nameIndex[i] != 0) {
+            int slot = nameIndex[i] - 1;
+            if (strcmp(fileName(slot), name) == 0) {
+                return slot;
+            }
+            i = (i + 1) & mask;
         }
-        int flag = -1;
-        ESP_ERROR_CHECK(esp_himem_map(memptr, rangeptr, lastPage * ESP_HIMEM_BLKSZ, 0, ESP_HIMEM_BLKSZ, 0, (void**)&records));
-        for (int i = 0; i < fileIndex; i++) {
-            for (int j = 0; j <= filename.length(); j++) {
-                // Compare characters one by one
-                if (records[i].filename[j] != filename.charAt(j)) {
-                    break; // Mismatch found, break inner loop
+        return -1;
+    }
+
+    #define HIMEM_TEST_WORDS (ESP_HIMEM_BLKSZ / sizeof(uint32_t))
+
+    /**
+     * Address-in-address pattern, the index of the word across the whole store
+     */
+    static inline uint32_t addressWord(unsigned int page, uint32_t i) {
+        return page * HIMEM_TEST_WORDS + i;
+    }
+
+    /**
+     * Pseudo random pattern, every word is computed on its own so a bank can be walked in any order
+     */
+    static inline uint32_t randomWord(unsigned int page, uint32_t i) {
+        uint32_t x = (page * HIMEM_TEST_WORDS + i) * 0x9E3779B1u;
+        x ^= x >> 15;
+        x *= 0x85EBCA77u;
+        return x ^ (x >> 13);
+    }
+
+    /**
+     * One memoryTest() pass over a mapped bank
+     * 0: walking ones and zeros through the first 32 words, then sequential address-in-address writes
+     * 1: sequential reads of the addresses, then strided random writes
+     * 2: strided reads of the random pattern
+     * micros gets the time of the sequential write, sequential read, strided write and strided read loops
+     * @return number of bad words, firstBad is set to the first
+     */
+    static uint32_t testBank(int pass, unsigned int page, uint32_t* words, uint32_t* loopMicros, uint32_t& firstBad) {
+        const uint32_t stride = HIMEM_TEST_STRIDE / sizeof(uint32_t);
+        uint32_t errors = 0;
+        unsigned long start;
+        if (pass == 0) {
+            volatile uint32_t* bus = words;
+            for (uint32_t bit = 0; bit < 32; bit++) {
+                bus[bit] = 1u << bit;
+                bus[bit + 32] = ~(1u << bit);
+            }
+            for (uint32_t bit = 0; bit < 32; bit++) {
+                if (bus[bit] != 1u << bit && errors++ == 0) firstBad = bit;
+                if (bus[bit + 32] != ~(1u << bit) && errors++ == 0) firstBad = bit + 32;
+            }
+            start = micros();
+            for (uint32_t i = 0; i < HIMEM_TEST_WORDS; i++) {
+                words[i] = addressWord(page, i);
+            }
+            loopMicros[0] += micros() - start;
+        } else if (pass == 1) {
+            start = micros();
+            for (uint32_t i = 0; i < HIMEM_TEST_WORDS; i++) {
+                if (words[i] != addressWord(page, i) && errors++ == 0) firstBad = i;
+            }
+            loopMicros[1] += micros() - start;
+            start = micros();
+            for (uint32_t k = 0; k < stride; k++) {
+                for (uint32_t i = k; i < HIMEM_TEST_WORDS; i += stride) {
+                    words[i] = randomWord(page, i);
                 }
-                // If we reach the null terminator in both strings, they match
-                if (records[i].filename[j] == '\0' && j == filename.length()) {
-                    flag = i;
-                    break;
+            }
+            loopMicros[2] += micros() - start;
+        } else {
+            start = micros();
+            for (uint32_t k = 0; k < stride; k++) {
+                for (uint32_t i = k; i < HIMEM_TEST_WORDS; i += stride) {
+                    if (words[i] != randomWord(page, i) && errors++ == 0) firstBad = i;
                 }
             }
-            if (flag != -1) {
-                break; // Match found, break outer loop
+            loopMicros[3] += micros() - start;
+        }
+        return errors;
+    }
+
+    /**
+     * KB/s of a loop that covered every bank in elapsed microseconds
+     */
+    static uint32_t rateKBps(uint32_t banks, uint32_t elapsed) {
+        return (elapsed == 0) ? 0 : (uint32_t)((uint64_t)banks * (ESP_HIMEM_BLKSZ / 1024) * 1000000 / elapsed);
+    }
+
+    boolean HIMEM::memoryTest() {
+        HimemTestResult result;
+        return memoryTest(result);
+    }
+
+    /* ----------------------------------------------------------- 
+    * Test every bank of the store and measure its speed
+    * Three passes over all banks, each bank mapped once per pass:
+    * walking ones and zeros through the first words of each bank plus
+    * address-in-address writes, reads of the addresses (a bank that
+    * lands on another shows up as wrong addresses) with strided pseudo
+    * random writes, and strided reads of the random pattern. 4 MiB of
+    * HIMEM costs about 16 MiB of PSRAM traffic, a second or two at boot.
+    * All files and baselines are erased and no other task may use the
+    * store while it runs.
+    * @param result - error counts, map latency and read/write rates
+    * @param bankErrors - if set, gets the bad words of each bank, capped at 65535
+    * @param maxBanks - entries in bankErrors
+    * @return true if every bank read back correctly
+    ----------------------------------------------------------------*/
+    boolean HIMEM::memoryTest(HimemTestResult& result, uint16_t* bankErrors, uint16_t maxBanks) {
+        result = {};
+        result.firstBadBank = -1;
+        if (!isInitialized) {
+            ESP_LOGE("memoryTest", "HIMEM not initialized");
+            return false;
+        }
+        if (viewPins > 0) {
+            ESP_LOGE("memoryTest", "A HimemView holds the map window");
+            return false;
+        }
+        unsigned long start = millis();
+        unsigned int banks = lastPage + 1;
+        uint32_t* bad = (uint32_t*)heap_caps_calloc(banks, sizeof(uint32_t), MALLOC_CAP_8BIT);
+        if (bad == nullptr) {
+            ESP_LOGE("memoryTest", "Failed to allocate %d bank counters", banks);
+            return false;
+        }
+        result.banks = banks;
+        uint32_t maps = mapStats.maps;
+        uint32_t mapMicros = mapStats.mapMicros;
+        uint32_t loopMicros[4] = {};
+        bool mapped = true;
+        for (int pass = 0; pass < 3 && mapped; pass++) {
+            for (unsigned int page = 0; page < banks; page++) {
+                lockWindow();
+                uint32_t* words = (uint32_t*)pagePtr(page);
+                if (words == nullptr) {
+                    unlockWindow();
+                    ESP_LOGE("memoryTest", "Failed to map HIMEM page %d", page);
+                    mapped = false;
+                    break;
+                }
+                uint32_t firstBad = 0;
+                uint32_t errors = testBank(pass, page, words, loopMicros, firstBad);
+                unlockWindow();
+                if (errors > 0) {
+                    ESP_LOGE("memoryTest", "Bank %d: %u bad words in pass %d, first at byte %u",
+                        page, (unsigned int)errors, pass, (unsigned int)(firstBad * sizeof(uint32_t)));
+                    bad[page] += errors;
+                }
             }
         }
-        if (flag == -1) {
-            ESP_LOGW("getID", "File %s not found", filename.c_str());
+        for (unsigned int page = 0; page < banks; page++) {
+            if (bad[page] > 0) {
+                result.errors += bad[page];
+                result.badBanks++;
+                if (result.firstBadBank < 0) result.firstBadBank = page;
+            }
+            if (bankErrors != nullptr && page < maxBanks) {
+                bankErrors[page] = (bad[page] > 0xFFFF) ? 0xFFFF : bad[page];
+            }
         }
-        ESP_ERROR_CHECK(esp_himem_unmap(rangeptr, records, ESP_HIMEM_BLKSZ));
-        return flag;
-    }
+        heap_caps_free(bad);
+        uint32_t mapCalls = mapStats.maps - maps;
+        result.mapMicros = (mapCalls == 0) ? 0 : (mapStats.mapMicros - mapMicros) / mapCalls;
+        result.writeKBps = rateKBps(banks, loopMicros[0]);
+        result.readKBps = rateKBps(banks, loopMicros[1]);
+        result.stridedWriteKBps = rateKBps(banks, loopMicros[2]);
+        result.stridedReadKBps = rateKBps(banks, loopMicros[3]);
 
-    boolean HIMEM::memoryTest(){
-        // Not yet implemented
-        return true;
+    /* Files, records and baselines were all overwritten */
+        freeMemory();
+        for (uint8_t i = 0; i < baselineSlots; i++) {
+            lockWindow();
+            uint8_t* header = pagePtr(baselinePage(i));
+            if (header != nullptr) {
+                memset(header, 0, sizeof(struct_HIMEM_BaselineInfo));
+            }
+            unlockWindow();
+            baselineState[i] = {};
+        }
+        baselineNext = 0;
+        baselineCount = 0;
+        result.millis = millis() - start;
+        ESP_LOGI("memoryTest", "%d banks, %u bad words in %d banks, map %u us, write %u KB/s, read %u KB/s, "
+            "strided write %u KB/s, strided read %u KB/s, %u ms", result.banks, (unsigned int)result.errors,
+            result.badBanks, (unsigned int)result.mapMicros, (unsigned int)result.writeKBps, (unsigned int)result.readKBps,
+            (unsigned int)result.stridedWriteKBps, (unsigned int)result.stridedReadKBps, (unsigned int)result.millis);
+        return mapped && result.errors == 0;
     }
 
     /**
@@ -505,13 +3184,34 @@ namespace HIMEMLIB {
         ESP_LOGI("MemStatus", "Range Allocated: %s", rangeAllocated ? "YES" : "NO");
         ESP_LOGI("MemStatus", "Memory Handle: %p", memptr);
         ESP_LOGI("MemStatus", "Range Handle: %p", rangeptr);
+        ESP_LOGI("MemStatus", "Pool: %s, banks %d to %d", (pool == &ownPool) ? "own" : "shared",
+            pageBase, pageBase + lastPage);
         
         if (isInitialized) {
             ESP_LOGI("MemStatus", "Total HIMEM Size: %lu bytes", himemSize);
-            ESP_LOGI("MemStatus", "Current Files: %d / %d", fileIndex, MAX_HIMEM_FILES);
-            ESP_LOGI("MemStatus", "Current Page: %d / %d", cPage, lastPage);
+            ESP_LOGI("MemStatus", "Mode: %s", concurrent ? "Concurrent" : (fifoMode ? "FIFO" : "Fill once"));
+            ESP_LOGI("MemStatus", "Current Files: %d / %d", getFileCount(), MAX_HIMEM_FILES);
+            ESP_LOGI("MemStatus", "Baselines: %d slots of %d banks, %d pushed", baselineSlots, baselineBanks, baselineCount);
+            ESP_LOGI("MemStatus", "File IDs: %d to %d", getOldestID(), getNewestID());
+            int blocks = 0;
+            for (uint16_t b = 0; b < HIMEM_RECORD_BLOCKS; b++) {
+                if (recordBlocks[b] != nullptr) blocks++;
+            }
+            ESP_LOGI("MemStatus", "Record Blocks: %d of %d records, %d record banks", blocks, HIMEM_RECORD_BLOCK,
+                (int)recordBanks);
+            ESP_LOGI("MemStatus", "Dirty Records: %d", dirtyCount);
+            ESP_LOGI("MemStatus", "Map Window: %d banks, %d mapped from page %d", rangeBanks, windowBanks, windowPage);
+            ESP_LOGI("MemStatus", "Bank Switches: %u maps, %u window hits", mapStats.maps, mapStats.windowHits);
+            ESP_LOGI("MemStatus", "Current Page: %d / %d, highest %d", cPage, lastPage, opStats.highPage);
+            uint32_t failed = 0;
+            for (int i = 1; i < HIMEM_ERROR_CODES; i++) failed += opStats.writeErrors[i];
+            ESP_LOGI("MemStatus", "Writes: %u files, %u failed, max %u us; Reads: %u, %u failed, max %u us",
+                (unsigned int)opStats.writes, (unsigned int)failed, (unsigned int)opStats.writeLatency.maxMicros,
+                (unsigned int)opStats.reads, (unsigned int)opStats.readErrors, (unsigned int)opStats.readLatency.maxMicros);
             ESP_LOGI("MemStatus", "Current Offset: %d bytes", cOffset);
             ESP_LOGI("MemStatus", "Free Space: %lu bytes", freespace());
+            ESP_LOGI("MemStatus", "Holes: %d (%d%% of free space), %d deleted files", 
+                extentCount, getFragmentation(), deletedFiles);
             ESP_LOGI("MemStatus", "Memory Usage: %.1f%%", 
                 (float)((cPage * ESP_HIMEM_BLKSZ + cOffset) * 100) / himemSize);
         }
@@ -524,6 +3224,429 @@ namespace HIMEMLIB {
     }
     
 
+    /* ----------------------------------------------------------- 
+    * Write dirty file records from the internal RAM blocks back to
+    * their homes in the record banks, one bank switch per record bank
+    * @return SUCCESS, or INITIALIZATION_FAILED if a bank could not be mapped
+    ----------------------------------------------------------------*/
+    int HIMEM::flushRecords() {
+        if (!isInitialized) {
+            ESP_LOGW("flushRecords", "HIMEM not initialized");
+            return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+        }
+        if (dirtyCount == 0) {
+            return static_cast<int>(HimemError::SUCCESS);
+        }
+        lockWindow();
+        uint32_t end = (uint32_t)dirtyFirst + dirtyCount;
+        for (uint32_t slot = dirtyFirst; slot < end; ) {
+            uint32_t blockEnd = (slot / HIMEM_RECORD_BLOCK + 1) * HIMEM_RECORD_BLOCK;
+            uint32_t last = (end < blockEnd) ? end : blockEnd;
+            RecordBlock* block = recordBlocks[slot / HIMEM_RECORD_BLOCK];
+            if (block != nullptr) {                 // freed blocks only held retired files
+                uint8_t* page = pagePtr(recordPage(block->home));
+                if (page == nullptr) {
+                    unlockWindow();
+                    ESP_LOGE("flushRecords", "Failed to map HIMEM for file info");
+                    return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+                }
+                struct_HIMEM_FileInfo* home = (struct_HIMEM_FileInfo*)page +
+                    (block->home % HIMEM_BLOCKS_PER_BANK) * HIMEM_RECORD_BLOCK;
+                uint32_t first = slot % HIMEM_RECORD_BLOCK;
+                memcpy(&home[first], &block->records[first], (last - slot) * sizeof(struct_HIMEM_FileInfo));
+            }
+            slot = last;
+        }
+        unlockWindow();
+        dirtyFirst = 0;
+        dirtyCount = 0;
+        return static_cast<int>(HimemError::SUCCESS);
+    }
+
+    /**
+     * Number of dirty records that triggers an automatic flushRecords(), 0 = flush only on request
+     */
+    void HIMEM::setRecordFlushThreshold(uint16_t records) {
+        flushThreshold = records;
+    }
+
+    /**
+     * Tag stored with the files written from now on, e.g. the event a frame belongs to, 0 = none
+     */
+    void HIMEM::setTag(uint16_t tag) {
+        writeTag = tag;
+    }
+
+    /* ----------------------------------------------------------- 
+    * Take a CRC-32 of the files written from now on
+    * The checksum of a plain file is taken while it is copied into the
+    * map window, and readFile() checks it while copying it out, so a
+    * PSRAM bit flip or an overwritten file is reported instead of
+    * returned as data. Compressed and delta files are checksummed over
+    * their original data. Files copied by setBaseline() have none.
+    * @param enable - true to checksum new files
+    ----------------------------------------------------------------*/
+    void HIMEM::setChecksums(bool enable) {
+        checksums = enable;
+    }
+
+    /**
+     * Extend the dirty record window to include slot and flush when the threshold is reached
+     */
+    void HIMEM::markRecordDirty(uint16_t slot) {
+        extendDirty(slot);
+        if (flushThreshold != 0 && dirtyCount >= flushThreshold) {
+            flushRecords();
+        }
+    }
+
+    void HIMEM::extendDirty(uint16_t slot) {
+        if (dirtyCount == 0) {
+            dirtyFirst = slot;
+            dirtyCount = 1;
+        } else if (slot < dirtyFirst) {
+            dirtyCount += dirtyFirst - slot;
+            dirtyFirst = slot;
+        } else if (slot >= dirtyFirst + dirtyCount) {
+            dirtyCount = slot - dirtyFirst + 1;
+        }
+    }
+
+    /* ----------------------------------------------------------- 
+    * Bank mapping statistics
+    * @return map/unmap calls, window hits/misses and time spent switching banks
+    ----------------------------------------------------------------*/
+    HimemMapStats HIMEM::getMapStats() {
+        lockWindow();
+        HimemMapStats stats = mapStats;
+        unlockWindow();
+        stats.windowBanks = rangeBanks;
+        return stats;
+    }
+
+    void HIMEM::resetMapStats() {
+        lockWindow();
+        mapStats = {};
+        unlockWindow();
+    }
+
+    /* ----------------------------------------------------------- 
+    * Get the operation counters, e.g. to send to telemetry
+    * Writes and reads are counted by the task that makes them, so in
+    * concurrent mode a count taken from a third task can be one call
+    * behind. The file count, free space, fragmentation and map counters
+    * are taken when called.
+    * @return counters since create() or resetStats()
+    ----------------------------------------------------------------*/
+    HimemStats HIMEM::getStats() {
+        lockWindow();
+        HimemStats stats = opStats;
+        unlockWindow();
+        stats.map = getMapStats();
+        if (isInitialized) {
+            stats.files = getFileCount();
+            stats.freeBytes = freespace();
+            stats.fragmentation = getFragmentation();
+        }
+        return stats;
+    }
+
+    void HIMEM::resetStats() {
+        lockWindow();
+        opStats = {};
+        unlockWindow();
+        resetMapStats();
+    }
+
+    /**
+     * Count a file write call that started at start, result is its file ID or error
+     */
+    int HIMEM::countWrite(int result, uint32_t bytes, uint16_t files, unsigned long start) {
+        addLatency(opStats.writeLatency, micros() - start);
+        if (result < 0) {
+            if (-result < HIMEM_ERROR_CODES) {
+                opStats.writeErrors[-result]++;
+            }
+            return result;
+        }
+        opStats.writes += files;
+        opStats.writeBytes += bytes;
+        if (cPage > opStats.highPage) {
+            opStats.highPage = cPage;
+        }
+        return result;
+    }
+
+    /**
+     * Count a readFile() call that started at start, bytes is its result
+     */
+    uint32_t HIMEM::countRead(uint32_t bytes, unsigned long start) {
+        addLatency(opStats.readLatency, micros() - start);
+        if (bytes == 0) {
+            opStats.readErrors++;
+        } else {
+            opStats.reads++;
+            opStats.readBytes += bytes;
+        }
+        return bytes;
+    }
+
+    /**
+     * Add a call that took elapsed microseconds to a histogram
+     */
+    void HIMEM::addLatency(HimemHistogram& histogram, uint32_t elapsed) {
+        uint8_t bucket = 0;
+        while (bucket < HIMEM_STAT_BUCKETS - 1 && (elapsed >> (bucket + 1)) != 0) {
+            bucket++;
+        }
+        histogram.buckets[bucket]++;
+        histogram.calls++;
+        if (elapsed > histogram.maxMicros) {
+            histogram.maxMicros = elapsed;
+        }
+    }
+
+    /**
+     * Guard the shared map window, only taken in concurrent mode
+     */
+    void HIMEM::lockWindow() {
+        if (concurrent) {
+            xSemaphoreTake(windowLock, portMAX_DELAY);
+        }
+    }
+
+    void HIMEM::unlockWindow() {
+        if (concurrent) {
+            xSemaphoreGive(windowLock);
+        }
+    }
+
+    /* ----------------------------------------------------------- 
+    * Get a pointer to a HIMEM page through the resident map window
+    * The window stays mapped between calls, a bank switch only happens
+    * when page is outside it. The pointer is valid until the next call.
+    * @param page - HIMEM page to access
+    * @param banks - optional output, contiguous banks mapped from page on
+    * @param minBanks - banks from page on that must be resident
+    * @return pointer to the start of page, nullptr if mapping failed
+    ----------------------------------------------------------------*/
+    uint8_t* HIMEM::pagePtr(unsigned int page, unsigned int* banks, unsigned int minBanks) {
+        if (windowPtr != nullptr && page >= windowPage && page + minBanks <= windowPage + windowBanks) {
+            mapStats.windowHits++;
+            if (banks != nullptr) *banks = windowPage + windowBanks - page;
+            return windowPtr + (size_t)(page - windowPage) * ESP_HIMEM_BLKSZ;
+        }
+        if (viewPins > 0) {
+            ESP_LOGE("pagePtr", "Page %d is outside the window held by %d file view(s)", page, viewPins);
+            return nullptr;
+        }
+        mapStats.windowMisses++;
+        if (releaseWindow() != ESP_OK) {
+            return nullptr;
+        }
+        unsigned int count = lastPage + 1 - page;
+        if (count > rangeBanks) count = rangeBanks;
+        unsigned long start = micros();
+        mapStats.maps++;
+        esp_err_t ret = esp_himem_map(memptr, rangeptr, (size_t)(pageBase + page) * ESP_HIMEM_BLKSZ, 0,
+            (size_t)count * ESP_HIMEM_BLKSZ, 0, (void**)&windowPtr);
+        mapStats.mapMicros += micros() - start;
+        if (ret != ESP_OK) {
+            ESP_LOGE("pagePtr", "Failed to map HIMEM page %d: %s", page, esp_err_to_name(ret));
+            windowPtr = nullptr;
+            return nullptr;
+        }
+        windowPage = page;
+        windowBanks = count;
+        if (banks != nullptr) *banks = count;
+        return windowPtr;
+    }
+
+    /* ----------------------------------------------------------- 
+    * Zero copy access to a stored file
+    * The file is mapped in the map window and the returned view points
+    * straight at it. A file that fits in the window, any file under 32k
+    * with the default 2 bank window, is a single span and data() points
+    * at all of it. A larger file, or one that wraps around the FIFO, is
+    * split into spans of up to a window each; span(i) maps them one at
+    * a time. While any view is held the window cannot move, so other
+    * HIMEM calls that need a different bank fail until the view is
+    * released or goes out of scope.
+    * @param id - file ID
+    * @return view of the file, check valid() before use
+    ----------------------------------------------------------------*/
+    HimemView HIMEM::viewFile(int id) {
+        HimemView view;
+        if (!isInitialized) {
+            ESP_LOGE("viewFile", "HIMEM not initialized");
+            return view;
+        }
+        if (concurrent) {
+            ESP_LOGE("viewFile", "File views are not available in concurrent mode, use readFile()");
+            return view;
+        }
+        int slot = findSlot(id, "viewFile");
+        if (slot < 0) {
+            return view;
+        }
+        if (record(slot).flags & (HIMEM_FILE_COMPRESSED | HIMEM_FILE_DELTA)) {
+            ESP_LOGE("viewFile", "File %d is stored compressed or as a delta, use readFile()", id);
+            return view;
+        }
+        if (slot == moveSlot && !settleMove()) {
+            return view;
+        }
+        view.page = record(slot).page;
+        view.offset = record(slot).offset;
+        view.bytes = record(slot).fileSize;
+        uint16_t spanPage = 0;
+        uint32_t spanOffset = 0;
+        uint32_t spanBytes = 0;
+        view.spanCount = viewSpans(view.page, view.offset, view.bytes, 0, spanPage, spanOffset, spanBytes);
+        viewPins++;
+        view.owner = this;
+        if (!mapSpan(view, 0)) {
+            view.release();
+        }
+        return view;
+    }
+
+    /**
+     * Split a stored range into spans that can be mapped at once, at most a window
+     * each and not across the end of the FIFO. Fills in span index
+     * @return number of spans
+     */
+    uint16_t HIMEM::viewSpans(uint16_t page, uint32_t offset, uint32_t bytes, uint16_t index,
+                              uint16_t& spanPage, uint32_t& spanOffset, uint32_t& spanBytes) {
+        uint16_t count = 0;
+        unsigned int end = regionEnd(page);
+        do {
+            unsigned int banks = (rangeBanks < end - page) ? rangeBanks : end - page;
+            uint32_t chunk = banks * ESP_HIMEM_BLKSZ - offset;
+            if (chunk > bytes) chunk = bytes;
+            if (count == index) {
+                spanPage = page;
+                spanOffset = offset;
+                spanBytes = chunk;
+            }
+            count++;
+            bytes -= chunk;
+            page += (offset + chunk) / ESP_HIMEM_BLKSZ;
+            offset = (offset + chunk) % ESP_HIMEM_BLKSZ;
+            if (fifoMode && page >= end) {
+                page = 0;
+            }
+        } while (bytes > 0);
+        return count;
+    }
+
+    /**
+     * Map span i of a view, the window may move for it if no other view holds it
+     */
+    bool HIMEM::mapSpan(HimemView& view, uint16_t i) {
+        uint16_t spanPage = 0;
+        uint32_t spanOffset = 0;
+        uint32_t spanBytes = 0;
+        viewSpans(view.page, view.offset, view.bytes, i, spanPage, spanOffset, spanBytes);
+        unsigned int pages = (spanOffset + spanBytes + ESP_HIMEM_BLKSZ - 1) / ESP_HIMEM_BLKSZ;
+        viewPins--;                                 // this view's own pin does not hold the window
+        uint8_t* ptr = pagePtr(spanPage, nullptr, pages ? pages : 1);
+        viewPins++;
+        if (ptr == nullptr) {
+            view.ptr = nullptr;
+            view.mapped = view.spanCount;           // nothing of the file is mapped now
+            view.mappedBytes = 0;
+            return false;
+        }
+        view.ptr = ptr + spanOffset;
+        view.mapped = i;
+        view.mappedBytes = spanBytes;
+        return true;
+    }
+
+    /**
+     * Called when a HimemView is released, the window may move again once all views are gone
+     */
+    void HIMEM::unpinWindow() {
+        if (viewPins > 0) {
+            viewPins--;
+        }
+    }
+
+    /**
+     * HimemView, RAII guard returned by HIMEM::viewFile()
+     */
+    HimemView::HimemView(HimemView&& other) {
+        *this = static_cast<HimemView&&>(other);
+    }
+
+    HimemView& HimemView::operator=(HimemView&& other) {
+        if (this != &other) {
+            release();
+            owner = other.owner;
+            ptr = other.ptr;
+            bytes = other.bytes;
+            page = other.page;
+            offset = other.offset;
+            spanCount = other.spanCount;
+            mapped = other.mapped;
+            mappedBytes = other.mappedBytes;
+            other.owner = nullptr;
+            other.release();
+        }
+        return *this;
+    }
+
+    HimemView::~HimemView() {
+        release();
+    }
+
+    /**
+     * Span i of the file, mapping it if needed. Returns {nullptr, 0} if i is
+     * out of range or the span could not be mapped
+     */
+    HimemSpan HimemView::span(uint16_t i) {
+        if (owner == nullptr || i >= spanCount) {
+            return {nullptr, 0};
+        }
+        if (i != mapped && !owner->mapSpan(*this, i)) {
+            return {nullptr, 0};
+        }
+        return {ptr, mappedBytes};
+    }
+
+    void HimemView::release() {
+        if (owner != nullptr) {
+            owner->unpinWindow();
+        }
+        owner = nullptr;
+        ptr = nullptr;
+        bytes = 0;
+        spanCount = 0;
+        mapped = 0;
+        mappedBytes = 0;
+    }
+
+    /**
+     * Unmap the resident window, if any
+     */
+    esp_err_t HIMEM::releaseWindow() {
+        if (windowPtr == nullptr) {
+            return ESP_OK;
+        }
+        unsigned long start = micros();
+        mapStats.unmaps++;
+        esp_err_t ret = esp_himem_unmap(rangeptr, windowPtr, (size_t)windowBanks * ESP_HIMEM_BLKSZ);
+        mapStats.mapMicros += micros() - start;
+        if (ret != ESP_OK) {
+            ESP_LOGE("releaseWindow", "Failed to unmap HIMEM page %d: %s", windowPage, esp_err_to_name(ret));
+            return ret;
+        }
+        windowPtr = nullptr;
+        windowBanks = 0;
+        return ESP_OK;
+    }
+
     struct_HIMEM_FileInfo HIMEM::getRecord(int id){
         struct_HIMEM_FileInfo info = {}; // Initialize to zero
         
@@ -532,14 +3655,12 @@ namespace HIMEMLIB {
             return info;
         }
         
-        //Serial.printf("fileIndex: %d, requested id: %d\n", fileIndex, id);  
-        if (id >= 0 && id < fileIndex) {
-            ESP_ERROR_CHECK(esp_himem_map(memptr, rangeptr, lastPage * ESP_HIMEM_BLKSZ, 0, ESP_HIMEM_BLKSZ, 0, (void**)&records));
-            info = records[id];
+        //Serial.printf("files: %d, requested id: %d\n", getFileCount(), id);  
+        int slot = slotForID(id);
+        if (slot >= 0) {
+            info = record(slot);
             //Serial.printf("ID: %d, Name: %s, Size: %u bytes, Page: %d, Offset: %d\n", 
-            //    records[id].ID, records[id].filename, records[id].fileSize, records[id].page, records[id].offset);
-
-            ESP_ERROR_CHECK(esp_himem_unmap(rangeptr, records, ESP_HIMEM_BLKSZ));
+            //    id, fileName(slot), info.fileSize, info.page, info.offset);
         }
         return info;
     }
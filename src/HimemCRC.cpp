@@ -0,0 +1,78 @@
+#include "HimemCRC.h"
+#include <string.h>
+
+#define CRC_POLY 0xEDB88320u
+
+namespace HIMEMLIB {
+
+    struct CrcTables {
+        uint32_t t[8][256];
+    };
+
+    /**
+     * t[0] is the byte table, t[k] the CRC of a byte followed by k zero bytes
+     */
+    static CrcTables buildTables() {
+        CrcTables tables;
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc & 1) ? (crc >> 1) ^ CRC_POLY : crc >> 1;
+            }
+            tables.t[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; i++) {
+            for (int k = 1; k < 8; k++) {
+                uint32_t prev = tables.t[k - 1][i];
+                tables.t[k][i] = (prev >> 8) ^ tables.t[0][prev & 0xFF];
+            }
+        }
+        return tables;
+    }
+
+    static const CrcTables& crcTables() {
+        static const CrcTables tables = buildTables();
+        return tables;
+    }
+
+    /**
+     * Slicing-by-8 loop shared by crc32() and crc32Copy(), the 8 byte words are read little endian
+     */
+    template <bool copy>
+    static inline uint32_t crcLoop(uint32_t crc, uint8_t* dst, const uint8_t* src, uint32_t bytes) {
+        const uint32_t (*t)[256] = crcTables().t;
+        crc = ~crc;
+        while (bytes >= 8) {
+            uint32_t lo;
+            uint32_t hi;
+            memcpy(&lo, src, 4);
+            memcpy(&hi, src + 4, 4);
+            if (copy) {
+                memcpy(dst, &lo, 4);
+                memcpy(dst + 4, &hi, 4);
+                dst += 8;
+            }
+            lo ^= crc;
+            crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+                  t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+            src += 8;
+            bytes -= 8;
+        }
+        while (bytes-- > 0) {
+            uint8_t b = *src++;
+            if (copy) {
+                *dst++ = b;
+            }
+            crc = (crc >> 8) ^ t[0][(crc ^ b) & 0xFF];
+        }
+        return ~crc;
+    }
+
+    uint32_t crc32(uint32_t crc, const uint8_t* data, uint32_t bytes) {
+        return crcLoop<false>(crc, nullptr, data, bytes);
+    }
+
+    uint32_t crc32Copy(uint32_t crc, uint8_t* dst, const uint8_t* src, uint32_t bytes) {
+        return crcLoop<true>(crc, dst, src, bytes);
+    }
+}
@@ -0,0 +1,365 @@
+#include "HimemDrain.h"
+
+#define CHUNK_FIRST 0x01                   // first chunk of a file, sink opens it
+#define CHUNK_LAST 0x02                    // last chunk of a file, sink closes it
+#define CHUNK_FAILED 0x04                  // file could not be read completely
+#define CHUNK_STOP 0x08                    // end(), sink task exits
+
+namespace HIMEMLIB {
+
+    /**
+     * Directory sink
+     */
+    HimemDirSink::HimemDirSink(const char* dir) : dir(dir) {
+    }
+
+    HimemDirSink::~HimemDirSink() {
+        if (file != nullptr) {
+            close(false);
+        }
+    }
+
+    bool HimemDirSink::open(const char* name, uint32_t size) {
+        (void)size;
+        path = dir + "/" + name;
+        file = fopen(path.c_str(), "wb");
+        if (file == nullptr) {
+            ESP_LOGE("HimemDirSink", "Failed to open %s for writing", path.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    bool HimemDirSink::write(const uint8_t* data, uint32_t bytes) {
+        return fwrite(data, 1, bytes, file) == bytes;
+    }
+
+    bool HimemDirSink::close(bool complete) {
+        bool ok = fclose(file) == 0;
+        file = nullptr;
+        if (!complete || !ok) {
+            remove(path.c_str());                   // do not leave partial files behind
+        }
+        return ok;
+    }
+
+    /**
+     * Constructor, the tasks are started by begin()
+     */
+    HimemDrain::HimemDrain(HIMEM& store, HimemSink& sink) : store(store), sink(sink) {
+    }
+
+    HimemDrain::~HimemDrain() {
+        end();
+    }
+
+    /* -----------------------------------------------------------
+    * Allocate the chunk buffers and start the read and sink tasks
+    * @param core - core both tasks run on, the camera usually owns core 1
+    * @param priority - task priority
+    * @param buffers - chunk buffers in the pool, 2 or more
+    * @param bufferSize - bytes per chunk buffer
+    * @return SUCCESS, INITIALIZATION_FAILED if memory or tasks could not be allocated
+    ----------------------------------------------------------------*/
+    int HimemDrain::begin(BaseType_t core, UBaseType_t priority, uint8_t buffers, uint32_t bufferSize) {
+        if (running) {
+            ESP_LOGW("drain", "Drain already running");
+            return static_cast<int>(HimemError::SUCCESS);
+        }
+        if (buffers < 2) buffers = 2;
+        if (bufferSize == 0) bufferSize = HIMEM_DRAIN_BUFFER_SIZE;
+        chunkCount = buffers;
+        chunkSize = bufferSize;
+        requests = xQueueCreate(HIMEM_DRAIN_REQUESTS, sizeof(Request));
+        freeChunks = xQueueCreate(buffers, sizeof(Chunk*));
+        fullChunks = xQueueCreate(buffers, sizeof(Chunk*));
+        idle = xSemaphoreCreateBinary();
+        stopped = xSemaphoreCreateBinary();
+        chunks = (Chunk*)heap_caps_calloc(buffers, sizeof(Chunk), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (requests == nullptr || freeChunks == nullptr || fullChunks == nullptr ||
+            idle == nullptr || stopped == nullptr || chunks == nullptr) {
+            ESP_LOGE("drain", "Failed to allocate drain queues");
+            freeResources();
+            return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+        }
+        for (int i = 0; i < buffers; i++) {
+            chunks[i].data = (uint8_t*)heap_caps_malloc(bufferSize, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+            if (chunks[i].data == nullptr) {
+                ESP_LOGE("drain", "Failed to allocate %u byte drain buffer", bufferSize);
+                freeResources();
+                return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+            }
+            Chunk* chunk = &chunks[i];
+            xQueueSend(freeChunks, &chunk, 0);
+        }
+        files = 0;
+        failures = 0;
+        bytes = 0;
+        readMicros = 0;
+        sinkMicros = 0;
+        bufferWaits = 0;
+        inFlight = 0;
+
+        if (xTaskCreatePinnedToCore(sinkTask, "himem_sink", HIMEM_DRAIN_STACK, this, priority, NULL, core) != pdPASS) {
+            ESP_LOGE("drain", "Failed to start the sink task");
+            freeResources();
+            return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+        }
+        if (xTaskCreatePinnedToCore(readTask, "himem_drain", HIMEM_DRAIN_STACK, this, priority, NULL, core) != pdPASS) {
+            ESP_LOGE("drain", "Failed to start the read task");
+            Chunk* chunk = &chunks[0];
+            xQueueReceive(freeChunks, &chunk, portMAX_DELAY);
+            chunk->flags = CHUNK_STOP;
+            xQueueSend(fullChunks, &chunk, portMAX_DELAY);
+            xSemaphoreTake(stopped, portMAX_DELAY);
+            freeResources();
+            return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+        }
+        running = true;
+        return static_cast<int>(HimemError::SUCCESS);
+    }
+
+    /* -----------------------------------------------------------
+    * Write everything queued so far, then stop the tasks and free the buffers
+    ----------------------------------------------------------------*/
+    void HimemDrain::end() {
+        if (!running) {
+            return;
+        }
+        Request request = {0, -1, false, true};
+        xQueueSend(requests, &request, portMAX_DELAY);
+        xSemaphoreTake(stopped, portMAX_DELAY);
+        running = false;
+        freeResources();
+    }
+
+    void HimemDrain::freeResources() {
+        if (chunks != nullptr) {
+            for (int i = 0; i < chunkCount; i++) {
+                heap_caps_free(chunks[i].data);
+            }
+            heap_caps_free(chunks);
+            chunks = nullptr;
+        }
+        if (requests != nullptr) vQueueDelete(requests);
+        if (freeChunks != nullptr) vQueueDelete(freeChunks);
+        if (fullChunks != nullptr) vQueueDelete(fullChunks);
+        if (idle != nullptr) vSemaphoreDelete(idle);
+        if (stopped != nullptr) vSemaphoreDelete(stopped);
+        requests = nullptr;
+        freeChunks = nullptr;
+        fullChunks = nullptr;
+        idle = nullptr;
+        stopped = nullptr;
+    }
+
+    /* -----------------------------------------------------------
+    * Queue files to be written to the sink, oldest first
+    * Blocks while HIMEM_DRAIN_REQUESTS calls are already queued. Unless the
+    * store is in concurrent mode it must not be used by anyone else until
+    * waitIdle() returns.
+    * @param firstID - first file ID
+    * @param lastID - last file ID
+    * @param release - releaseFile() each file once it has been written, FIFO
+    *                  or concurrent mode only. Files are released even if
+    *                  the sink failed so the writer is never stalled, the
+    *                  completion callback reports the failure.
+    * @return SUCCESS, negative on error
+    ----------------------------------------------------------------*/
+    int HimemDrain::drain(int firstID, int lastID, bool release) {
+        if (!running) {
+            ESP_LOGE("drain", "Drain not started, call begin()");
+            return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+        }
+        if (firstID < 0 || lastID < firstID) {
+            ESP_LOGE("drain", "Invalid file ID range %d to %d", firstID, lastID);
+            return static_cast<int>(HimemError::INVALID_ID);
+        }
+        inFlight += lastID - firstID + 1;
+        Request request = {firstID, lastID, release, false};
+        xQueueSend(requests, &request, portMAX_DELAY);
+        return static_cast<int>(HimemError::SUCCESS);
+    }
+
+    /**
+     * Wait until every queued file has been closed by the sink, false on timeout
+     */
+    bool HimemDrain::waitIdle(TickType_t ticks) {
+        while (inFlight > 0) {
+            if (xSemaphoreTake(idle, ticks) != pdTRUE) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    uint32_t HimemDrain::pending() {
+        return inFlight;
+    }
+
+    /**
+     * Called from the sink task after each file, must not block for long
+     */
+    void HimemDrain::onFileDone(HimemDrainCallback callback, void* context) {
+        doneCallback = callback;
+        doneContext = context;
+    }
+
+    HimemDrainStats HimemDrain::getStats() {
+        HimemDrainStats stats;
+        stats.files = files;
+        stats.failures = failures;
+        stats.bytes = bytes;
+        stats.readMicros = readMicros;
+        stats.sinkMicros = sinkMicros;
+        stats.bufferWaits = bufferWaits;
+        return stats;
+    }
+
+    /* -----------------------------------------------------------
+    * Read task, copies requested files out of HIMEM into chunk buffers
+    ----------------------------------------------------------------*/
+    void HimemDrain::readTask(void* param) {
+        HimemDrain* self = (HimemDrain*)param;
+        Request request;
+        while (xQueueReceive(self->requests, &request, portMAX_DELAY) == pdTRUE && !request.stop) {
+            for (int id = request.firstID; id <= request.lastID; id++) {
+                self->readOne(id, request.release);
+            }
+        }
+        // Hand the stop on behind the chunks still queued for the sink
+        Chunk* chunk = self->takeChunk();
+        chunk->flags = CHUNK_STOP;
+        xQueueSend(self->fullChunks, &chunk, portMAX_DELAY);
+        vTaskDelete(NULL);
+    }
+
+    /**
+     * Copy one file into chunks, the last chunk is always sent even if the read failed
+     */
+    void HimemDrain::readOne(int id, bool release) {
+        current = takeChunk();
+        waitMicros = 0;
+        unsigned long start = micros();
+        current->id = id;
+        current->fileSize = store.getFilesize(id);
+        current->release = release;
+        current->bytes = 0;
+        current->flags = CHUNK_FIRST;
+        store.getFileName(id).toCharArray(current->name, sizeof(current->name));
+        uint32_t bytesRead = 0;
+        if (current->fileSize > 0) {
+            bytesRead = store.readFile(id, fillChunk, this);
+        }
+        if (bytesRead != current->fileSize || current->fileSize == 0) {
+            ESP_LOGE("drain", "Failed to read file %d", id);
+            current->flags |= CHUNK_FAILED;
+        }
+        current->flags |= CHUNK_LAST;
+        readMicros += (micros() - start) - waitMicros;       // waiting for the sink is not read time
+        xQueueSend(fullChunks, &current, portMAX_DELAY);
+        current = nullptr;
+    }
+
+    /**
+     * readFile() sink, fills the current chunk and passes full chunks to the sink task
+     */
+    bool HimemDrain::fillChunk(const uint8_t* data, uint32_t bytes, void* context) {
+        HimemDrain* self = (HimemDrain*)context;
+        while (bytes > 0) {
+            Chunk* chunk = self->current;
+            if (chunk->bytes == self->chunkSize) {
+                self->sendChunk(chunk->flags & CHUNK_FIRST);
+                continue;
+            }
+            uint32_t n = self->chunkSize - chunk->bytes;
+            if (n > bytes) n = bytes;
+            memcpy(chunk->data + chunk->bytes, data, n);
+            chunk->bytes += n;
+            data += n;
+            bytes -= n;
+        }
+        return true;
+    }
+
+    /**
+     * Take a free chunk buffer, waiting for the sink task if all of them are queued
+     */
+    HimemDrain::Chunk* HimemDrain::takeChunk() {
+        Chunk* chunk;
+        if (xQueueReceive(freeChunks, &chunk, 0) != pdTRUE) {
+            bufferWaits++;
+            xQueueReceive(freeChunks, &chunk, portMAX_DELAY);
+        }
+        return chunk;
+    }
+
+    /**
+     * Queue the full current chunk and start the next one of the same file
+     */
+    void HimemDrain::sendChunk(uint8_t flags) {
+        Chunk* full = current;
+        full->flags = flags;
+        unsigned long start = micros();
+        xQueueSend(fullChunks, &full, portMAX_DELAY);
+        current = takeChunk();
+        waitMicros += micros() - start;
+        current->id = full->id;
+        current->fileSize = full->fileSize;
+        current->release = full->release;
+        current->bytes = 0;
+        current->flags = 0;
+    }
+
+    /* -----------------------------------------------------------
+    * Sink task, writes chunks to the sink and reports finished files
+    ----------------------------------------------------------------*/
+    void HimemDrain::sinkTask(void* param) {
+        HimemDrain* self = (HimemDrain*)param;
+        Chunk* chunk;
+        bool fileOpen = false;
+        bool fileOk = false;
+        while (xQueueReceive(self->fullChunks, &chunk, portMAX_DELAY) == pdTRUE) {
+            if (chunk->flags & CHUNK_STOP) {
+                break;
+            }
+            unsigned long start = micros();
+            if (chunk->flags & CHUNK_FIRST) {
+                fileOpen = self->sink.open(chunk->name, chunk->fileSize);
+                fileOk = fileOpen;
+            }
+            if (fileOk && chunk->bytes > 0) {
+                fileOk = self->sink.write(chunk->data, chunk->bytes);
+                if (fileOk) self->bytes += chunk->bytes;
+            }
+            if (chunk->flags & CHUNK_LAST) {
+                bool ok = fileOk && !(chunk->flags & CHUNK_FAILED);
+                if (fileOpen) {
+                    ok = self->sink.close(ok) && ok;
+                }
+                fileOpen = false;
+                self->sinkMicros += micros() - start;
+                if (chunk->release) {
+                    self->store.releaseFile(chunk->id);
+                }
+                if (ok) {
+                    self->files++;
+                } else {
+                    self->failures++;
+                }
+                if (self->doneCallback != nullptr) {
+                    self->doneCallback(chunk->id, ok, self->doneContext);
+                }
+                if (--self->inFlight == 0) {
+                    xSemaphoreGive(self->idle);
+                }
+            } else {
+                self->sinkMicros += micros() - start;
+            }
+            xQueueSend(self->freeChunks, &chunk, portMAX_DELAY);
+        }
+        xSemaphoreGive(self->stopped);
+        vTaskDelete(NULL);
+    }
+
+} // namespace HIMEMLIB
@@ -0,0 +1,157 @@
+#include "HimemLZ.h"
+#include <string.h>
+
+#define LZ_MIN_MATCH 4
+#define LZ_LAST_LITERALS 5                                        // a block always ends with literals
+#define LZ_MATCH_LIMIT 12                                         // no match starts in the last 12 bytes
+#define LZ_EMPTY 0xFFFF
+
+namespace HIMEMLIB {
+
+    static inline uint32_t read32(const uint8_t* p) {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static inline uint32_t lzHash(uint32_t sequence) {
+        return (sequence * 2654435761u) >> (32 - HIMEM_LZ_HASH_BITS);
+    }
+
+    /**
+     * Write a length that did not fit in its token nibble
+     */
+    static inline uint8_t* putLength(uint8_t* op, uint32_t length) {
+        while (length >= 255) {
+            *op++ = 255;
+            length -= 255;
+        }
+        *op++ = (uint8_t)length;
+        return op;
+    }
+
+    /* -----------------------------------------------------------
+    * Compress one block, greedy single probe match finder
+    * @param src - data to compress, at most HIMEM_LZ_BLOCK bytes
+    * @param bytes - number of bytes in src
+    * @param dst - output, at least bytes long
+    * @param table - match finder table, 1 << HIMEM_LZ_HASH_BITS entries
+    * @return compressed size, 0 if the block does not compress
+    ----------------------------------------------------------------*/
+    uint32_t lzCompress(const uint8_t* src, uint32_t bytes, uint8_t* dst, uint16_t* table) {
+        const uint8_t* ip = src;
+        const uint8_t* anchor = src;
+        const uint8_t* end = src + bytes;
+        uint8_t* op = dst;
+        uint8_t* outEnd = dst + bytes;
+
+        memset(table, 0xFF, sizeof(uint16_t) << HIMEM_LZ_HASH_BITS);
+        if (bytes > LZ_MATCH_LIMIT) {
+            const uint8_t* limit = end - LZ_MATCH_LIMIT;
+            while (ip < limit) {
+                uint32_t sequence = read32(ip);
+                uint32_t h = lzHash(sequence);
+                uint16_t candidate = table[h];
+                table[h] = (uint16_t)(ip - src);
+                if (candidate == LZ_EMPTY || read32(src + candidate) != sequence) {
+                    ip += 1 + ((ip - anchor) >> 6);     // step up through data that does not compress
+                    continue;
+                }
+                const uint8_t* match = src + candidate;
+                uint32_t length = LZ_MIN_MATCH;
+                while (ip + length < end - LZ_LAST_LITERALS && ip[length] == match[length]) {
+                    length++;
+                }
+                uint32_t literals = ip - anchor;
+                // token, literal count, literals, offset and match length must fit
+                if (op + 1 + literals / 255 + 1 + literals + 2 + (length - LZ_MIN_MATCH) / 255 + 1 >= outEnd) {
+                    return 0;
+                }
+                uint8_t* token = op++;
+                *token = (uint8_t)(((literals < 15) ? literals : 15) << 4);
+                if (literals >= 15) op = putLength(op, literals - 15);
+                memcpy(op, anchor, literals);
+                op += literals;
+                uint32_t offset = ip - match;
+                *op++ = (uint8_t)offset;
+                *op++ = (uint8_t)(offset >> 8);
+                uint32_t extra = length - LZ_MIN_MATCH;
+                *token |= (uint8_t)((extra < 15) ? extra : 15);
+                if (extra >= 15) op = putLength(op, extra - 15);
+                ip += length;
+                anchor = ip;
+            }
+        }
+        uint32_t literals = end - anchor;
+        if (op + 1 + literals / 255 + 1 + literals >= outEnd) {
+            return 0;
+        }
+        *op++ = (uint8_t)(((literals < 15) ? literals : 15) << 4);
+        if (literals >= 15) op = putLength(op, literals - 15);
+        memcpy(op, anchor, literals);
+        op += literals;
+        return op - dst;
+    }
+
+    /* -----------------------------------------------------------
+    * Decompress one block, every length and offset is checked
+    * @param src - compressed block
+    * @param bytes - compressed size
+    * @param dst - output
+    * @param outBytes - size the block must decode to
+    * @return false if the block is corrupt
+    ----------------------------------------------------------------*/
+    bool lzDecompress(const uint8_t* src, uint32_t bytes, uint8_t* dst, uint32_t outBytes) {
+        const uint8_t* ip = src;
+        const uint8_t* end = src + bytes;
+        uint8_t* op = dst;
+        uint8_t* outEnd = dst + outBytes;
+
+        while (ip < end) {
+            uint8_t token = *ip++;
+            uint32_t literals = token >> 4;
+            if (literals == 15) {
+                uint8_t b;
+                do {
+                    if (ip >= end) return false;
+                    b = *ip++;
+                    literals += b;
+                } while (b == 255);
+            }
+            if (literals > (uint32_t)(end - ip) || literals > (uint32_t)(outEnd - op)) {
+                return false;
+            }
+            memcpy(op, ip, literals);
+            ip += literals;
+            op += literals;
+            if (ip == end) {
+                break;                              // last sequence, literals only
+            }
+            if (end - ip < 2) return false;
+            uint32_t offset = ip[0] | (ip[1] << 8);
+            ip += 2;
+            uint32_t length = token & 15;
+            if (length == 15) {
+                uint8_t b;
+                do {
+                    if (ip >= end) return false;
+                    b = *ip++;
+                    length += b;
+                } while (b == 255);
+            }
+            length += LZ_MIN_MATCH;
+            if (offset == 0 || offset > (uint32_t)(op - dst) || length > (uint32_t)(outEnd - op)) {
+                return false;
+            }
+            const uint8_t* match = op - offset;
+            if (offset >= length) {
+                memcpy(op, match, length);
+                op += length;
+            } else {
+                while (length--) *op++ = *match++;  // overlapping run
+            }
+        }
+        return op == outEnd;
+    }
+
+} // namespace HIMEMLIB
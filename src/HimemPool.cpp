@@ -0,0 +1,164 @@
+#include "HIMEM.h"
+
+namespace HIMEMLIB {
+
+    HimemPool::~HimemPool() {
+        end();
+    }
+
+    /* -----------------------------------------------------------
+    * Allocate the HIMEM shared by the stores of this pool
+    * @param banks - banks to allocate, 0 for all free HIMEM
+    * @return SUCCESS, negative on error
+    ----------------------------------------------------------------*/
+    int HimemPool::begin(uint16_t banks) {
+        if (memptr != nullptr) {
+            ESP_LOGE("begin", "HIMEM pool already allocated");
+            return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+        }
+        if (esp_himem_get_phys_size() == 0) {
+            ESP_LOGE("begin", "HIMEM not initialized make sure -D BOARD_HAS_PSRAM is set");
+            return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+        }
+        size_t freeBytes = esp_himem_get_free_size();
+        size_t bytes = (banks == 0) ? freeBytes - ESP_HIMEM_BLKSZ : (size_t)banks * ESP_HIMEM_BLKSZ;  //Reserve one block when taking all
+        if (bytes <= ESP_HIMEM_BLKSZ || bytes > freeBytes) {
+            ESP_LOGE("begin", "Not enough HIMEM available, only %u bytes", (unsigned int)freeBytes);
+            return static_cast<int>(HimemError::INSUFFICIENT_MEMORY);
+        }
+        esp_err_t ret = esp_himem_alloc(bytes, &memptr);
+        if (ret != ESP_OK) {
+            ESP_LOGE("begin", "Failed to allocate HIMEM: %s", esp_err_to_name(ret));
+            memptr = nullptr;
+            return static_cast<int>(HimemError::INITIALIZATION_FAILED);
+        }
+        this->banks = bytes / ESP_HIMEM_BLKSZ;
+        storeCount = 0;
+        return static_cast<int>(HimemError::SUCCESS);
+    }
+
+    /**
+     * Free the map ranges and HIMEM, refused while stores still use the pool
+     */
+    void HimemPool::end() {
+        if (storeCount > 0) {
+            ESP_LOGE("end", "%d store(s) still use the HIMEM pool, destroy them first", storeCount);
+            return;
+        }
+        for (uint8_t i = 0; i < rangeCount; i++) {
+            esp_err_t ret = esp_himem_free_map_range(ranges[i].handle);
+            if (ret != ESP_OK) {
+                ESP_LOGE("cleanup", "Failed to free map range: %s", esp_err_to_name(ret));
+            }
+        }
+        if (rangeCount > 0) {
+            ESP_LOGI("cleanup", "Map range freed successfully");
+        }
+        rangeCount = 0;
+        if (memptr != nullptr) {
+            esp_err_t ret = esp_himem_free(memptr);
+            if (ret != ESP_OK) {
+                ESP_LOGE("cleanup", "Failed to free HIMEM: %s", esp_err_to_name(ret));
+            } else {
+                ESP_LOGI("cleanup", "HIMEM freed successfully");
+            }
+            memptr = nullptr;
+        }
+        banks = 0;
+    }
+
+    uint16_t HimemPool::totalBanks() {
+        return banks;
+    }
+
+    uint16_t HimemPool::freeBanks() {
+        uint16_t used = 0;
+        for (uint8_t i = 0; i < storeCount; i++) {
+            used += stores[i].banks;
+        }
+        return banks - used;
+    }
+
+    /**
+     * First fit run of banks for a new store
+     * @return first bank of the run, -1 if there is no run that long
+     */
+    int HimemPool::takeBanks(HIMEM* owner, uint16_t count) {
+        if (memptr == nullptr || count < 2 || storeCount == HIMEM_POOL_STORES) {
+            return -1;                              // a store needs a data page and a record page
+        }
+        uint16_t first = 0;
+        uint8_t i = 0;
+        for (; i < storeCount; i++) {
+            if (stores[i].first - first >= count) {
+                break;
+            }
+            first = stores[i].first + stores[i].banks;
+        }
+        if (i == storeCount && banks - first < count) {
+            return -1;
+        }
+        memmove(&stores[i + 1], &stores[i], (storeCount - i) * sizeof(Store));
+        stores[i].owner = owner;
+        stores[i].first = first;
+        stores[i].banks = count;
+        storeCount++;
+        return first;
+    }
+
+    void HimemPool::giveBanks(HIMEM* owner) {
+        for (uint8_t i = 0; i < storeCount; i++) {
+            if (stores[i].owner == owner) {
+                storeCount--;
+                memmove(&stores[i], &stores[i + 1], (storeCount - i) * sizeof(Store));
+                return;
+            }
+        }
+    }
+
+    /* -----------------------------------------------------------
+    * Map range for a store, an unused range of the pool if there is one
+    * of the right size, otherwise a new one. Falls back to fewer banks
+    * when the reserved area is short.
+    * @param banks - banks wanted, set to the banks of the range returned
+    * @return range handle, nullptr if none could be found
+    ----------------------------------------------------------------*/
+    esp_himem_rangehandle_t HimemPool::takeRange(uint16_t& banks) {
+        for (uint16_t want = banks; want > 0; want /= 2) {
+            for (uint8_t i = 0; i < rangeCount; i++) {
+                if (!ranges[i].used && ranges[i].banks == want) {
+                    ranges[i].used = true;
+                    banks = want;
+                    return ranges[i].handle;
+                }
+            }
+            esp_himem_rangehandle_t handle = nullptr;
+            if (rangeCount < HIMEM_POOL_RANGES &&
+                esp_himem_alloc_map_range((size_t)want * ESP_HIMEM_BLKSZ, &handle) == ESP_OK) {
+                ranges[rangeCount].handle = handle;
+                ranges[rangeCount].banks = want;
+                ranges[rangeCount].used = true;
+                rangeCount++;
+                banks = want;
+                return handle;
+            }
+            if (want > 1) {
+                ESP_LOGW("create", "No room for a %d bank map range, trying %d", want, want / 2);
+            }
+        }
+        ESP_LOGE("create", "Failed to allocate map range");
+        return nullptr;
+    }
+
+    /**
+     * Keep a store's map range for the next store
+     */
+    void HimemPool::giveRange(esp_himem_rangehandle_t handle) {
+        for (uint8_t i = 0; i < rangeCount; i++) {
+            if (ranges[i].handle == handle) {
+                ranges[i].used = false;
+            }
+        }
+    }
+
+} // namespace HIMEMLIB
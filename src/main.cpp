@@ -32,7 +32,7 @@ void setup() {
   }
 
   /* set file number 2 as the baseline */  
-  int ret = himem.setBaseline(2, fileBuf, fileBufSize);                //need to provide buffer and size to setBaseline
+  int ret = himem.setBaseline(2);                                       //copied inside HIMEM, no buffer needed
   if (ret < 0) {
     ESP_LOGE("setup", "Failed to set baseline to file ID 2, return value %d", ret);
     stop;